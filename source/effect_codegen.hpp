@@ -8,6 +8,7 @@
 #include "effect_lexer.hpp"
 #include <algorithm>
 #include <memory>
+#include <unordered_set>
 
 namespace reshadefx
 {
@@ -28,6 +29,17 @@ namespace reshadefx
 		/// <param name="module">The target module to fill.</param>
 		virtual void write_result(module &module) = 0;
 
+		/// <summary>
+		/// Returns the number of functions that were left out of the result, because no entry point can reach them.
+		/// This is only valid after the result was written with <see cref="write_result"/>.
+		/// </summary>
+		size_t num_removed_functions() const { return _num_removed_functions; }
+		/// <summary>
+		/// Returns the size in bytes of the code that was left out of the result, because no entry point can reach it.
+		/// This is only valid after the result was written with <see cref="write_result"/>.
+		/// </summary>
+		size_t removed_code_size() const { return _removed_code_size; }
+
 	public:
 		/// <summary>
 		/// An opaque ID referring to a SSA value or basic block.
@@ -93,6 +105,17 @@ namespace reshadefx
 		/// <param name="is_ps"><c>true</c> if this is a pixel shader, <c>false</c> if it is a vertex shader.</param>
 		virtual void define_entry_point(const function_info &function, bool is_ps) = 0;
 
+		/// <summary>
+		/// Record that the current function references another function or a global variable.
+		/// References made outside of a function (e.g. by a technique) mark the target as always used.
+		/// Any function or global variable that cannot be reached through these references is left out of the result.
+		/// </summary>
+		/// <param name="id">The SSA ID of the referenced function or variable.</param>
+		void add_reference(id id)
+		{
+			_references[is_in_function() ? _functions.back()->definition : 0].push_back(id);
+		}
+
 		/// <summary>
 		/// Resolve the access chain and add a load operation to the output.
 		/// </summary>
@@ -294,9 +317,34 @@ namespace reshadefx
 	protected:
 		id make_id() { return _next_id++; }
 
+		/// <summary>
+		/// Find all functions and global variables that are reachable from the global scope (or the specified function) through the references recorded with <see cref="add_reference"/>.
+		/// </summary>
+		/// <param name="root">The function to start searching from, or zero to start from the global scope. It is part of the result itself.</param>
+		std::unordered_set<id> find_referenced(id root = 0) const
+		{
+			std::unordered_set<id> referenced = { root };
+			std::vector<id> pending = { root };
+			while (!pending.empty())
+			{
+				const auto it = _references.find(pending.back());
+				pending.pop_back();
+				if (it == _references.end())
+					continue;
+
+				for (const id target : it->second)
+					if (referenced.insert(target).second)
+						pending.push_back(target);
+			}
+			return referenced;
+		}
+
 		module _module;
 		std::vector<struct_info> _structs;
 		std::vector<std::unique_ptr<function_info>> _functions;
+		std::unordered_map<id, std::vector<id>> _references;
+		size_t _num_removed_functions = 0;
+		size_t _removed_code_size = 0;
 		id _next_id = 1;
 		id _last_block = 0;
 		id _current_block = 0;
@@ -322,4 +370,13 @@ namespace reshadefx
 	/// <param name="debug_info">Whether to append debug information like line directives to the generated code.</param>
 	/// <param name="uniforms_to_spec_constants">Whether to convert uniform variables to specialization constants.</param>
 	codegen *create_codegen_spirv(bool vulkan_semantics, bool debug_info, bool uniforms_to_spec_constants);
+
+	/// <summary>
+	/// Create a code generation implementation that records all code into an intermediate representation first and then passes it on to other back-ends when the result is written.
+	/// This makes it possible to generate code for several targets from a single pass of the parser.
+	/// </summary>
+	/// <param name="backends">The back-ends to generate the final code with. They have to stay alive until the result was written. The result of the first one is what gets written to the module, the others receive the same code and can write their result themselves afterwards.</param>
+	/// <param name="optimize">Whether to run loop unrolling, common subexpression elimination, constant folding, copy propagation and dead code elimination on the recorded code before passing it on.</param>
+	/// <param name="max_unrolled_size">The maximum number of instructions a loop with a trip count known at compile-time may grow to by unrolling it. Loops with an [unroll] attribute are unrolled regardless of their size.</param>
+	codegen *create_codegen_ir(std::vector<codegen *> backends, bool optimize, unsigned int max_unrolled_size);
 }
@@ -34,6 +34,20 @@ private:
 		expression,
 	};
 
+	// Range of code in the global block that defines a function or global variable, so that it can be left out if nothing references it
+	struct removable_range
+	{
+		id definition;
+		size_t begin, end;
+		bool is_function;
+	};
+	// Range of code in the global block that declares the inputs, outputs and generated 'main' function of an entry point, including the conditional around it
+	struct entry_point_range
+	{
+		id definition;
+		size_t begin, code_begin, code_end, end;
+	};
+
 	std::string _ubo_block;
 	std::unordered_map<id, std::string> _names;
 	std::unordered_map<id, std::string> _blocks;
@@ -41,12 +55,17 @@ private:
 	bool _uniforms_to_spec_constants = false;
 	unsigned int _current_ubo_offset = 0;
 	std::unordered_map<id, id> _remapped_sampler_variables;
+	size_t _current_function_begin = 0;
+	std::pair<id, size_t> _last_global_constant;
+	std::vector<removable_range> _removable_ranges;
+	std::vector<entry_point_range> _entry_point_ranges;
+	std::vector<id> _ubo_members;
 
 	void write_result(module &module) override
 	{
 		module = std::move(_module);
 
-		module.hlsl +=
+		std::string preamble =
 			"float hlsl_fmod(float x, float y) { return x - y * trunc(x / y); }\n"
 			" vec2 hlsl_fmod( vec2 x,  vec2 y) { return x - y * trunc(x / y); }\n"
 			" vec3 hlsl_fmod( vec3 x,  vec3 y) { return x - y * trunc(x / y); }\n"
@@ -54,10 +73,87 @@ private:
 			" mat2 hlsl_fmod( mat2 x,  mat2 y) { return x - matrixCompMult(y, mat2(trunc(x[0] / y[0]), trunc(x[1] / y[1]))); }\n"
 			" mat3 hlsl_fmod( mat3 x,  mat3 y) { return x - matrixCompMult(y, mat3(trunc(x[0] / y[0]), trunc(x[1] / y[1]), trunc(x[2] / y[2]))); }\n"
 			" mat4 hlsl_fmod( mat4 x,  mat4 y) { return x - matrixCompMult(y, mat4(trunc(x[0] / y[0]), trunc(x[1] / y[1]), trunc(x[2] / y[2]), trunc(x[3] / y[3]))); }\n";
+		const size_t preamble_size = preamble.size();
 
+		// The uniform block layout is shared by all entry points, so it is not changed here, but only left out entirely when an entry point does not use any of its members
 		if (!_ubo_block.empty())
-			module.hlsl += "layout(std140, binding = 0) uniform _Globals {\n" + _ubo_block + "};\n";
-		module.hlsl += _blocks.at(0);
+			preamble += "layout(std140, binding = 0) uniform _Globals {\n" + _ubo_block + "};\n";
+
+		// Append the global block, but leave out all functions and global variables that no entry point can reach
+		const std::unordered_set<id> referenced = find_referenced();
+
+		for (const removable_range &range : _removable_ranges)
+		{
+			if (referenced.find(range.definition) != referenced.end())
+				continue;
+
+			_removed_code_size += range.end - range.begin;
+			_num_removed_functions += range.is_function;
+		}
+
+		module.hlsl += preamble;
+		write_global_block(module.hlsl, referenced, nullptr);
+
+		// Generate source code for each entry point separately too, containing only what it uses, so that drivers do not have to parse the code of all other entry points every time
+		assert(module.entry_points.size() == _entry_point_ranges.size());
+
+		for (size_t i = 0; i < module.entry_points.size(); ++i)
+		{
+			const entry_point_range &entry_point = _entry_point_ranges[i];
+			const std::unordered_set<id> entry_point_referenced = find_referenced(entry_point.definition);
+
+			std::string &code = module.entry_points[i].code;
+			code.assign(preamble, 0, std::any_of(_ubo_members.begin(), _ubo_members.end(),
+				[&entry_point_referenced](const id member) { return entry_point_referenced.find(member) != entry_point_referenced.end(); }) ? preamble.size() : preamble_size);
+			write_global_block(code, entry_point_referenced, &entry_point);
+		}
+	}
+
+	/// <summary>
+	/// Append the global block to the specified string, leaving out all functions and global variables that are not in the referenced set.
+	/// </summary>
+	/// <param name="entry_point">The only entry point to include without the conditional around it, or <c>nullptr</c> to include all of them.</param>
+	void write_global_block(std::string &s, const std::unordered_set<id> &referenced, const entry_point_range *entry_point) const
+	{
+		std::vector<std::pair<size_t, size_t>> skipped_ranges;
+		for (const removable_range &range : _removable_ranges)
+			if (referenced.find(range.definition) == referenced.end())
+				skipped_ranges.emplace_back(range.begin, range.end);
+
+		if (entry_point != nullptr)
+		{
+			for (const entry_point_range &range : _entry_point_ranges)
+			{
+				if (&range == entry_point)
+				{
+					skipped_ranges.emplace_back(range.begin, range.code_begin);
+					skipped_ranges.emplace_back(range.code_end, range.end);
+				}
+				else
+				{
+					skipped_ranges.emplace_back(range.begin, range.end);
+				}
+			}
+
+			// Entry point ranges contain the range of their generated function, so need to sort and handle overlaps
+			std::sort(skipped_ranges.begin(), skipped_ranges.end());
+		}
+
+		const std::string &code = _blocks.at(0);
+		size_t offset = 0;
+		for (const auto &[begin, end] : skipped_ranges)
+		{
+			if (begin > offset)
+				s.append(code, offset, begin - offset);
+			offset = std::max(offset, end);
+		}
+
+		s.append(code, offset, std::string::npos);
+	}
+
+	void add_removable_range(id definition, size_t begin, bool is_function = false)
+	{
+		_removable_ranges.push_back({ definition, begin, _blocks.at(0).size(), is_function });
 	}
 
 	template <bool is_param = false, bool is_decl = true, bool is_interface = false>
@@ -91,6 +187,13 @@ private:
 				s += "out ";
 		}
 
+		if constexpr (is_decl)
+		{
+			// Precision qualifiers are only allowed in declarations, where they have to follow the storage qualifiers
+			if (type.base == type::t_min16float)
+				s += "mediump ";
+		}
+
 		switch (type.base)
 		{
 		case type::t_void:
@@ -120,6 +223,7 @@ private:
 			else
 				s += "uint";
 			break;
+		case type::t_min16float:
 		case type::t_float:
 			if (type.cols > 1)
 				s += "mat" + std::to_string(type.rows) + 'x' + std::to_string(type.cols);
@@ -185,6 +289,7 @@ private:
 			case type::t_uint:
 				s += std::to_string(data.as_uint[i]) + 'u';
 				break;
+			case type::t_min16float:
 			case type::t_float:
 				if (std::isnan(data.as_float[i])) {
 					s += "0.0/0.0/*nan*/";
@@ -214,7 +319,7 @@ private:
 	}
 	void write_location(std::string &s, const location &loc) const
 	{
-		if (loc.source.empty() || !_debug_info)
+		if (loc.source == 0 || !_debug_info)
 			return;
 
 		s += "#line " + std::to_string(loc.line) + '\n';
@@ -330,11 +435,14 @@ private:
 		_module.samplers.push_back(info);
 
 		std::string &code = _blocks.at(_current_block);
+		const size_t begin = code.size();
 
 		write_location(code, loc);
 
 		code += "layout(binding = " + std::to_string(info.binding) + ") uniform sampler2D " + id_to_name(info.id) + ";\n";
 
+		add_removable_range(info.id, begin);
+
 		return info.id;
 	}
 	id   define_uniform(const location &loc, uniform_info &info) override
@@ -346,6 +454,7 @@ private:
 		if (_uniforms_to_spec_constants && info.has_initializer_value)
 		{
 			std::string &code = _blocks.at(_current_block);
+			const size_t begin = code.size();
 
 			write_location(code, loc);
 
@@ -356,6 +465,8 @@ private:
 				write_type<false, false>(code, info.type);
 			code += "(SPEC_CONSTANT_" + info.name + ");\n";
 
+			add_removable_range(res, begin);
+
 			_module.spec_constants.push_back(info);
 		}
 		else
@@ -377,6 +488,8 @@ private:
 			write_type(_ubo_block, info.type);
 			_ubo_block += ' ' + id_to_name(res) + ";\n";
 
+			_ubo_members.push_back(res);
+
 			_module.uniforms.push_back(info);
 		}
 
@@ -395,6 +508,9 @@ private:
 
 		std::string &code = _blocks.at(_current_block);
 
+		// A constant array initializer was written right before the variable, so remove it along with it
+		const size_t begin = initializer_value != 0 && initializer_value == _last_global_constant.first ? _last_global_constant.second : code.size();
+
 		write_location(code, loc);
 
 		if (!global)
@@ -411,6 +527,9 @@ private:
 
 		code += ";\n";
 
+		if (global)
+			add_removable_range(res, begin);
+
 		return res;
 	}
 	id   define_function(const location &loc, function_info &info) override
@@ -427,6 +546,7 @@ private:
 			define_name<naming::unique>(info.definition, info.unique_name);
 
 		std::string &code = _blocks.at(_current_block);
+		_current_function_begin = code.size();
 
 		write_location(code, loc);
 
@@ -469,8 +589,13 @@ private:
 
 		_module.entry_points.push_back(entry_point_info { func.unique_name, is_ps });
 
+		entry_point_range range;
+		range.begin = _blocks.at(0).size();
+
 		_blocks.at(0) += "#ifdef ENTRY_POINT_" + func.unique_name + '\n';
 
+		range.code_begin = _blocks.at(0).size();
+
 		function_info entry_point;
 		entry_point.return_type = { type::t_void };
 
@@ -545,6 +670,8 @@ private:
 		define_function({}, entry_point, true);
 		enter_block(create_block());
 
+		add_reference(func.definition);
+
 		std::string &code = _blocks.at(_current_block);
 
 		// Handle input parameters
@@ -685,7 +812,16 @@ private:
 		leave_block_and_return(0);
 		leave_function();
 
+		// The generated entry point function is not referenced by any code, so explicitly keep it
+		add_reference(entry_point.definition);
+
+		range.definition = entry_point.definition;
+		range.code_end = _blocks.at(0).size();
+
 		_blocks.at(0) += "#endif\n";
+
+		range.end = _blocks.at(0).size();
+		_entry_point_ranges.push_back(range);
 	}
 
 	id   emit_load(const expression &exp, bool force_new_id) override
@@ -814,6 +950,9 @@ private:
 		{
 			std::string &code = _blocks.at(_current_block);
 
+			if (!is_in_block())
+				_last_global_constant = { res, code.size() };
+
 			code += '\t';
 
 			// GLSL requires constants to be initialized
@@ -1434,6 +1573,8 @@ private:
 		assert(_last_block != 0);
 
 		_blocks.at(0) += "{\n" + _blocks.at(_last_block) + "}\n";
+
+		add_removable_range(_functions.back()->definition, _current_function_begin, true);
 	}
 };
 
@@ -6,6 +6,7 @@
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
 #include <assert.h>
+#include <unordered_set>
 
 using namespace reshadefx;
 
@@ -31,8 +32,19 @@ private:
 		expression,
 	};
 
+	// Range of code in the global block that defines a function or global variable, so that it can be left out if nothing references it
+	struct removable_range
+	{
+		id definition;
+		size_t begin, end;
+		bool is_function;
+	};
+
 	std::string _cbuffer_block;
-	std::string _current_location;
+	uint32_t _current_location = 0;
+	size_t _current_function_begin = 0;
+	std::pair<id, size_t> _last_global_constant;
+	std::vector<removable_range> _removable_ranges;
 	std::unordered_map<id, std::string> _names;
 	std::unordered_map<id, std::string> _blocks;
 	bool _debug_info = false;
@@ -59,7 +71,32 @@ private:
 				module.hlsl += _cbuffer_block;
 		}
 
-		module.hlsl += _blocks.at(0);
+		// Append the global block, but leave out all functions and global variables that no entry point can reach
+		const std::unordered_set<id> referenced = find_referenced();
+
+		const std::string &code = _blocks.at(0);
+		size_t offset = 0;
+		for (const removable_range &range : _removable_ranges)
+		{
+			if (referenced.find(range.definition) != referenced.end())
+				continue;
+
+			module.hlsl.append(code, offset, range.begin - offset);
+			offset = range.end;
+
+			_removed_code_size += range.end - range.begin;
+			_num_removed_functions += range.is_function;
+		}
+
+		module.hlsl.append(code, offset, std::string::npos);
+	}
+
+	void add_removable_range(id definition, size_t begin, bool is_function = false)
+	{
+		_removable_ranges.push_back({ definition, begin, _blocks.at(0).size(), is_function });
+
+		// The range may be left out of the result, so the next line directive cannot rely on it having set the file name already
+		_current_location = 0;
 	}
 
 	template <bool is_param = false, bool is_decl = true>
@@ -105,6 +142,10 @@ private:
 			// In shader model 3, uints can only be used with known-positive values, so use ints instead
 			s += _shader_model >= 40 ? "uint" : "int";
 			break;
+		case type::t_min16float:
+			// Minimum precision types only exist since shader model 5, while shader model 3 treats 'half' as a precision hint
+			s += _shader_model >= 50 ? "min16float" : _shader_model >= 40 ? "float" : "half";
+			break;
 		case type::t_float:
 			s += "float";
 			break;
@@ -174,6 +215,7 @@ private:
 			case type::t_uint:
 				s += std::to_string(data.as_uint[i]);
 				break;
+			case type::t_min16float:
 			case type::t_float:
 				if (std::isnan(data.as_float[i])) {
 					s += "-1.#IND";
@@ -201,7 +243,7 @@ private:
 	template <bool force_source = false>
 	void write_location(std::string &s, const location &loc)
 	{
-		if (loc.source.empty() || !_debug_info)
+		if (loc.source == 0 || !_debug_info)
 			return;
 
 		s += "#line " + std::to_string(loc.line);
@@ -209,11 +251,11 @@ private:
 		// Avoid writing the file name every time to reduce output text size
 		if constexpr (force_source)
 		{
-			s += " \"" + loc.source + '\"';
+			s += " \"" + location::source_name(loc.source) + '\"';
 		}
 		else if (loc.source != _current_location)
 		{
-			s += " \"" + loc.source + '\"';
+			s += " \"" + location::source_name(loc.source) + '\"';
 
 			_current_location = loc.source;
 		}
@@ -362,9 +404,14 @@ private:
 			assert(info.srgb == 0 || info.srgb == 1);
 			info.texture_binding = texture->binding + info.srgb; // Offset binding by one to choose the SRGB variant
 
+			// The sampler state declaration above may be shared with other samplers, so only the combined sampler variable can be removed
+			const size_t begin = code.size();
+
 			write_location(code, loc);
 
 			code += "static const __sampler2D " + id_to_name(info.id) + " = { " + (info.srgb ? "__srgb" : "") + info.texture_name + ", __s" + std::to_string(info.binding) + " };\n";
+
+			add_removable_range(info.id, begin);
 		}
 		else
 		{
@@ -372,6 +419,8 @@ private:
 
 			code += "sampler2D __" + info.unique_name + "_s : register(s" + std::to_string(info.binding) + ");\n";
 
+			const size_t begin = code.size();
+
 			write_location(code, loc);
 
 			code += "static const __sampler2D " + id_to_name(info.id) + " = { __" + info.unique_name + "_s, float2(";
@@ -382,6 +431,8 @@ private:
 				code += texture->semantic + "_PIXEL_SIZE"; // Expect application to set inverse texture size via a define if it is not known here
 
 			code += ") }; \n";
+
+			add_removable_range(info.id, begin);
 		}
 
 		_module.samplers.push_back(info);
@@ -397,6 +448,7 @@ private:
 		if (_uniforms_to_spec_constants && info.has_initializer_value)
 		{
 			std::string &code = _blocks.at(_current_block);
+			const size_t begin = code.size();
 
 			write_location(code, loc);
 
@@ -407,6 +459,8 @@ private:
 				write_type<false, false>(code, info.type);
 			code += "(SPEC_CONSTANT_" + info.name + ");\n";
 
+			add_removable_range(res, begin);
+
 			_module.spec_constants.push_back(info);
 		}
 		else
@@ -456,6 +510,9 @@ private:
 
 		std::string &code = _blocks.at(_current_block);
 
+		// A constant array initializer was written right before the variable, so remove it along with it
+		const size_t begin = initializer_value != 0 && initializer_value == _last_global_constant.first ? _last_global_constant.second : code.size();
+
 		write_location(code, loc);
 
 		if (!global)
@@ -472,6 +529,9 @@ private:
 
 		code += ";\n";
 
+		if (global)
+			add_removable_range(res, begin);
+
 		return res;
 	}
 	id   define_function(const location &loc, function_info &info) override
@@ -488,6 +548,7 @@ private:
 		define_name<naming::unique>(info.definition, std::move(name));
 
 		std::string &code = _blocks.at(_current_block);
+		_current_function_begin = code.size();
 
 		write_location(code, loc);
 
@@ -622,6 +683,9 @@ private:
 
 		leave_block_and_return(func.return_type.is_void() ? 0 : ret);
 		leave_function();
+
+		// The generated entry point function is not referenced by any code, so explicitly keep it
+		add_reference(entry_point.definition);
 	}
 
 	id   emit_load(const expression &exp, bool force_new_id) override
@@ -727,6 +791,9 @@ private:
 		{
 			std::string &code = _blocks.at(_current_block);
 
+			if (!is_in_block())
+				_last_global_constant = { res, code.size() };
+
 			// Array constants need to be stored in a constant variable as they cannot be used in-place
 			code += "\tconst ";
 			write_type(code, type);
@@ -1362,6 +1429,8 @@ private:
 		assert(_last_block != 0);
 
 		_blocks.at(0) += "{\n" + _blocks.at(_last_block) + "}\n";
+
+		add_removable_range(_functions.back()->definition, _current_function_begin, true);
 	}
 };
 
@@ -0,0 +1,1556 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "effect_parser.hpp"
+#include "effect_codegen.hpp"
+#include <assert.h>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <unordered_set>
+
+using namespace reshadefx;
+
+class codegen_ir final : public codegen
+{
+public:
+	codegen_ir(std::vector<codegen *> backends, bool optimize, unsigned int max_unrolled_size)
+		: _backends(std::move(backends)), _optimize(optimize), _max_unrolled_size(max_unrolled_size)
+	{
+		assert(!_backends.empty());
+	}
+
+private:
+	enum class opcode
+	{
+		define_struct,
+		define_texture,
+		define_sampler,
+		define_uniform,
+		define_variable,
+		define_function,
+		define_entry_point,
+		emit_load,
+		emit_store,
+		emit_constant,
+		emit_unary_op,
+		emit_binary_op,
+		emit_ternary_op,
+		emit_call,
+		emit_call_intrinsic,
+		emit_construct,
+		emit_if,
+		emit_phi,
+		emit_loop,
+		emit_switch,
+		create_block,
+		set_block,
+		enter_block,
+		leave_block_and_kill,
+		leave_block_and_return,
+		leave_block_and_switch,
+		leave_block_and_branch,
+		leave_block_and_branch_conditional,
+		leave_function,
+	};
+
+	// A single recorded call into the code generation interface
+	struct instruction
+	{
+		opcode kind;
+		bool in_block = false;
+		bool dead = false;
+		tokenid op = tokenid::unknown;
+		id result = 0;
+		// Index into the list of definitions, constants or functions, or the ID of the called function or intrinsic
+		uint32_t index = 0;
+		unsigned int flags = 0;
+		location loc;
+		reshadefx::type type = {};
+		reshadefx::type operand_type = {};
+		std::vector<id> operands;
+		std::vector<expression> args;
+		std::string name;
+	};
+
+	const std::vector<codegen *> _backends;
+	const bool _optimize;
+	const unsigned int _max_unrolled_size;
+	std::deque<instruction> _instructions;
+	std::vector<constant> _constants;
+	std::unordered_set<id> _read_only_variables;
+
+	void write_result(module &module) override
+	{
+		if (_optimize)
+		{
+			unroll_loops();
+			optimize();
+		}
+
+		// The code only has to be parsed and optimized once, no matter how many back-ends it is passed on to
+		for (codegen *const backend : _backends)
+			replay(*backend);
+
+		_backends[0]->write_result(module);
+
+		_num_removed_functions = _backends[0]->num_removed_functions();
+		_removed_code_size = _backends[0]->removed_code_size();
+	}
+
+	/// <summary>
+	/// Pass all recorded instructions that were not optimized away on to the specified back-end, translating IDs as they go.
+	/// </summary>
+	void replay(codegen &backend) const
+	{
+		std::vector<id> id_map(_next_id);
+
+		const auto map_id = [&id_map](id value) { return id_map[value]; };
+		const auto map_type = [&](type type) {
+			if (type.is_struct())
+				type.definition = id_map[type.definition];
+			return type;
+		};
+		const auto map_args = [&](const std::vector<expression> &args) {
+			std::vector<expression> mapped_args = args;
+			for (expression &arg : mapped_args)
+			{
+				arg.type = map_type(arg.type);
+				if (!arg.is_constant)
+					arg.base = map_id(arg.base);
+
+				for (expression::operation &op : arg.chain)
+				{
+					op.from = map_type(op.from);
+					op.to = map_type(op.to);
+					if (op.op == expression::operation::op_dynamic_index)
+						op.index = map_id(op.index);
+				}
+			}
+			return mapped_args;
+		};
+
+		// References are recorded per function, so they have to be passed on while the back-end is inside the matching function
+		id function_with_pending_references = 0;
+
+		for (const instruction &inst : _instructions)
+		{
+			if (inst.dead)
+				continue;
+
+			switch (inst.kind)
+			{
+			case opcode::define_struct:
+			{
+				struct_info info = _structs[inst.index];
+				info.definition = 0;
+				for (struct_member_info &member : info.member_list)
+					member.type = map_type(member.type);
+				id_map[inst.result] = backend.define_struct(inst.loc, info);
+				break;
+			}
+			case opcode::define_texture:
+			{
+				texture_info info = _module.textures[inst.index];
+				info.id = 0;
+				id_map[inst.result] = backend.define_texture(inst.loc, info);
+				break;
+			}
+			case opcode::define_sampler:
+			{
+				sampler_info info = _module.samplers[inst.index];
+				info.id = 0;
+				id_map[inst.result] = backend.define_sampler(inst.loc, info);
+				break;
+			}
+			case opcode::define_uniform:
+			{
+				uniform_info info = _module.uniforms[inst.index];
+				info.type = map_type(info.type);
+				id_map[inst.result] = backend.define_uniform(inst.loc, info);
+				break;
+			}
+			case opcode::define_variable:
+				id_map[inst.result] = backend.define_variable(inst.loc, map_type(inst.type), inst.name, inst.flags != 0, map_id(inst.operands[0]));
+				break;
+			case opcode::define_function:
+			{
+				const function_info &recorded_info = *_functions[inst.index];
+				function_info info = recorded_info;
+				info.definition = 0;
+				info.return_type = map_type(info.return_type);
+				for (struct_member_info &param : info.parameter_list)
+				{
+					param.type = map_type(param.type);
+					param.definition = 0;
+				}
+				id_map[inst.result] = backend.define_function(inst.loc, info);
+				for (size_t i = 0; i < info.parameter_list.size(); ++i)
+					id_map[recorded_info.parameter_list[i].definition] = info.parameter_list[i].definition;
+				function_with_pending_references = inst.result;
+				break;
+			}
+			case opcode::define_entry_point:
+				backend.define_entry_point(backend.find_function(id_map[inst.index]), inst.flags != 0);
+				break;
+			case opcode::emit_load:
+				id_map[inst.result] = backend.emit_load(map_args(inst.args)[0], inst.flags != 0);
+				break;
+			case opcode::emit_store:
+				backend.emit_store(map_args(inst.args)[0], map_id(inst.operands[0]));
+				break;
+			case opcode::emit_constant:
+				id_map[inst.result] = backend.emit_constant(map_type(inst.type), _constants[inst.index]);
+				break;
+			case opcode::emit_unary_op:
+				id_map[inst.result] = backend.emit_unary_op(inst.loc, inst.op, map_type(inst.type), map_id(inst.operands[0]));
+				break;
+			case opcode::emit_binary_op:
+				id_map[inst.result] = backend.emit_binary_op(inst.loc, inst.op, map_type(inst.type), map_type(inst.operand_type), map_id(inst.operands[0]), map_id(inst.operands[1]));
+				break;
+			case opcode::emit_ternary_op:
+				id_map[inst.result] = backend.emit_ternary_op(inst.loc, inst.op, map_type(inst.type), map_id(inst.operands[0]), map_id(inst.operands[1]), map_id(inst.operands[2]));
+				break;
+			case opcode::emit_call:
+				id_map[inst.result] = backend.emit_call(inst.loc, id_map[inst.index], map_type(inst.type), map_args(inst.args));
+				break;
+			case opcode::emit_call_intrinsic:
+				id_map[inst.result] = backend.emit_call_intrinsic(inst.loc, inst.index, map_type(inst.type), map_args(inst.args));
+				break;
+			case opcode::emit_construct:
+				id_map[inst.result] = backend.emit_construct(inst.loc, map_type(inst.type), map_args(inst.args));
+				break;
+			case opcode::emit_if:
+				backend.emit_if(inst.loc, map_id(inst.operands[0]), map_id(inst.operands[1]), map_id(inst.operands[2]), map_id(inst.operands[3]), inst.flags);
+				break;
+			case opcode::emit_phi:
+				id_map[inst.result] = backend.emit_phi(inst.loc, map_id(inst.operands[0]), map_id(inst.operands[1]), map_id(inst.operands[2]), map_id(inst.operands[3]), map_id(inst.operands[4]), map_id(inst.operands[5]), map_type(inst.type));
+				break;
+			case opcode::emit_loop:
+				backend.emit_loop(inst.loc, map_id(inst.operands[0]), map_id(inst.operands[1]), map_id(inst.operands[2]), map_id(inst.operands[3]), map_id(inst.operands[4]), map_id(inst.operands[5]), inst.flags);
+				break;
+			case opcode::emit_switch:
+			{
+				// The operands after the selector value, selector block and default label alternate between case literals (which are not IDs) and labels
+				std::vector<id> case_literal_and_labels(inst.operands.begin() + 3, inst.operands.end());
+				for (size_t i = 1; i < case_literal_and_labels.size(); i += 2)
+					case_literal_and_labels[i] = map_id(case_literal_and_labels[i]);
+				backend.emit_switch(inst.loc, map_id(inst.operands[0]), map_id(inst.operands[1]), map_id(inst.operands[2]), case_literal_and_labels, inst.flags);
+				break;
+			}
+			case opcode::create_block:
+				id_map[inst.result] = backend.create_block();
+				break;
+			case opcode::set_block:
+				backend.set_block(map_id(inst.operands[0]));
+				break;
+			case opcode::enter_block:
+				backend.enter_block(map_id(inst.operands[0]));
+				if (function_with_pending_references != 0)
+				{
+					if (const auto it = _references.find(function_with_pending_references); it != _references.end())
+						for (const id target : it->second)
+							backend.add_reference(id_map[target]);
+					function_with_pending_references = 0;
+				}
+				break;
+			case opcode::leave_block_and_kill:
+				backend.leave_block_and_kill();
+				break;
+			case opcode::leave_block_and_return:
+				backend.leave_block_and_return(map_id(inst.operands[0]));
+				break;
+			case opcode::leave_block_and_switch:
+				backend.leave_block_and_switch(map_id(inst.operands[0]), map_id(inst.operands[1]));
+				break;
+			case opcode::leave_block_and_branch:
+				backend.leave_block_and_branch(map_id(inst.operands[0]), inst.flags);
+				break;
+			case opcode::leave_block_and_branch_conditional:
+				backend.leave_block_and_branch_conditional(map_id(inst.operands[0]), map_id(inst.operands[1]), map_id(inst.operands[2]));
+				break;
+			case opcode::leave_function:
+				backend.leave_function();
+				break;
+			}
+		}
+
+		// Pass on references made outside of functions (e.g. by techniques) and the techniques themselves last, after everything they refer to was defined
+		if (const auto it = _references.find(0); it != _references.end())
+			for (const id target : it->second)
+				backend.add_reference(id_map[target]);
+
+		for (technique_info info : _module.techniques)
+			backend.define_technique(info);
+	}
+
+	/// <summary>
+	/// Replace loops that run a number of times known at compile-time with a copy of their body for every iteration, as long as that does not grow the code beyond the size limit (or the loop has an [unroll] attribute).
+	/// The loop counter is replaced with its value in each copy, so that expressions and indices using it become constant and can be folded afterwards.
+	/// </summary>
+	void unroll_loops()
+	{
+		// Unrolling a loop can make the trip count of loops nested in it known (e.g. when their bound depends on the outer loop counter), so repeat until there are no such loops left
+		bool has_unrolled_nested_loops;
+		do
+		{
+			has_unrolled_nested_loops = false;
+
+			// Index of the last instruction that refers to each value or variable
+			std::vector<size_t> last_uses(_next_id);
+			for (size_t i = 0; i < _instructions.size(); ++i)
+				for_each_use(_instructions[i], [&last_uses, i](id value) { last_uses[value] = i; });
+
+			// Loops are nested inside each other, with inner loops ending first, so build the result in order and unroll each loop after all the code inside it was already processed
+			std::deque<instruction> instructions;
+			std::vector<id> replaced_blocks(_next_id);
+			bool has_replaced_blocks = false;
+
+			for (size_t i = 0; i < _instructions.size(); ++i)
+			{
+				instruction &inst = instructions.emplace_back(std::move(_instructions[i]));
+
+				if (has_replaced_blocks)
+					for_each_id(inst, [&replaced_blocks](id &value) {
+						if (value < replaced_blocks.size() && replaced_blocks[value] != 0)
+							value = replaced_blocks[value];
+					});
+
+				if (inst.kind == opcode::emit_loop && (inst.flags & 0x2) == 0)
+					has_replaced_blocks |= unroll_loop(instructions, [&last_uses, i](id variable) { return last_uses[variable] <= i; }, replaced_blocks, has_unrolled_nested_loops);
+			}
+
+			_instructions = std::move(instructions);
+		} while (has_unrolled_nested_loops);
+	}
+
+	/// <summary>
+	/// Try to unroll the loop at the end of the specified list of instructions.
+	/// </summary>
+	/// <param name="instructions">The list of instructions, ending with the loop merge block and the loop itself.</param>
+	/// <param name="is_unused_after_loop">Function that returns whether a variable is not referenced anymore after the loop.</param>
+	/// <param name="replaced_blocks">Blocks that code after the loop has to refer to by a different ID, since the loop merge block no longer exists after unrolling.</param>
+	/// <param name="has_unrolled_nested_loops">Set to <c>true</c> if the loop was unrolled and its body contains other loops.</param>
+	template <typename F>
+	bool unroll_loop(std::deque<instruction> &instructions, const F &is_unused_after_loop, std::vector<id> &replaced_blocks, bool &has_unrolled_nested_loops)
+	{
+		// The D3D compiler refuses to unroll loops with more iterations than this too
+		const size_t max_iterations = 1024;
+
+		const instruction &loop = instructions.back();
+		const bool force_unroll = (loop.flags & 0x1) != 0;
+		const id prev_block = loop.operands[1];
+		const id header_block = loop.operands[2];
+		const id last_block = loop.operands[4];
+		const id continue_block = loop.operands[5];
+
+		// Only loops with a condition evaluated before the body (i.e. no do-while loops) are supported
+		if (loop.operands[0] == 0 || loop.operands[3] == 0 || prev_block == 0 || instructions.size() < 8)
+			return false;
+
+		// Find the beginning of the loop and verify that its blocks are laid out the way the parser emits "for" loops:
+		// prev: branch header, header: branch condition, condition: branch conditional body/merge, continue: branch header, body: branch continue, merge
+		size_t header_index = instructions.size() - 2;
+		while (header_index-- > 1 && !(instructions[header_index].kind == opcode::enter_block && instructions[header_index].operands[0] == header_block))
+			continue;
+		if (header_index == 0 || header_index + 3 >= instructions.size())
+			return false;
+
+		const size_t prev_index = header_index - 1;
+		if (instructions[prev_index].kind != opcode::leave_block_and_branch || instructions[prev_index].operands[0] != header_block ||
+			instructions[header_index + 1].kind != opcode::leave_block_and_branch ||
+			instructions[header_index + 2].kind != opcode::enter_block || instructions[header_index + 2].operands[0] != instructions[header_index + 1].operands[0])
+			return false;
+
+		const id condition_block = instructions[header_index + 2].operands[0];
+		const size_t condition_begin = header_index + 3;
+		size_t condition_end = condition_begin;
+		while (condition_end < instructions.size() && is_value(instructions[condition_end]))
+			condition_end++;
+		if (condition_end + 2 >= instructions.size() || instructions[condition_end].kind != opcode::leave_block_and_branch_conditional ||
+			instructions[condition_end + 1].kind != opcode::enter_block || instructions[condition_end + 1].operands[0] != continue_block)
+			return false;
+
+		const id condition_value = instructions[condition_end].operands[0];
+		const id body_block = instructions[condition_end].operands[1];
+		const id merge_block = instructions[condition_end].operands[2];
+
+		const size_t continue_begin = condition_end + 2;
+		size_t continue_end = continue_begin;
+		while (continue_end < instructions.size() && (is_value(instructions[continue_end]) || instructions[continue_end].kind == opcode::emit_store))
+			continue_end++;
+		if (continue_end + 1 >= instructions.size() || instructions[continue_end].kind != opcode::leave_block_and_branch || instructions[continue_end].operands[0] != header_block ||
+			instructions[continue_end + 1].kind != opcode::enter_block || instructions[continue_end + 1].operands[0] != body_block)
+			return false;
+
+		const size_t body_begin = continue_end + 2;
+		const size_t body_end = instructions.size() - 3;
+		if (body_end < body_begin ||
+			instructions[body_end].kind != opcode::leave_block_and_branch || instructions[body_end].operands[0] != continue_block ||
+			instructions[body_end + 1].kind != opcode::enter_block || instructions[body_end + 1].operands[0] != merge_block)
+			return false;
+
+		// The variables written in the continue block are the loop counters, which have to be local variables that are not used anywhere but in the loop and start out with a constant value
+		std::vector<std::pair<id, const instruction *>> counters;
+		for (size_t i = continue_begin; i < continue_end; ++i)
+		{
+			if (instructions[i].kind != opcode::emit_store)
+				continue;
+
+			const expression &target = instructions[i].args[0];
+			if (!target.is_lvalue || !target.chain.empty() || !is_unused_after_loop(target.base))
+				return false;
+			if (std::none_of(counters.begin(), counters.end(), [&target](const auto &counter) { return counter.first == target.base; }))
+				counters.emplace_back(target.base, nullptr);
+		}
+		if (counters.empty())
+			return false;
+
+		for (auto &counter : counters)
+		{
+			// Local variables are assigned their initial value right after their definition, which has to happen in the same block as the loop starts
+			size_t store_index = prev_index;
+			bool is_used = false;
+			while (!is_used && store_index-- > 0)
+			{
+				const instruction &inst = instructions[store_index];
+				if (inst.kind == opcode::enter_block || inst.kind == opcode::set_block)
+					return false;
+				for_each_use(inst, [&is_used, &counter](id value) { is_used |= value == counter.first; });
+			}
+
+			if (!is_used || instructions[store_index].kind != opcode::emit_store || !instructions[store_index].args[0].chain.empty())
+				return false;
+
+			size_t definition_index = store_index;
+			while (definition_index-- > 0 && instructions[definition_index].result != counter.first)
+				continue;
+
+			// The initial value has to be a constant, which is usually emitted right before the variable
+			size_t value_index = store_index;
+			while (value_index-- > 0 && instructions[value_index].result != instructions[store_index].operands[0])
+				continue;
+			if (value_index < store_index && instructions[value_index].kind == opcode::emit_constant)
+				counter.second = &instructions[value_index];
+
+			if (counter.second == nullptr || definition_index >= store_index ||
+				instructions[definition_index].kind != opcode::define_variable || instructions[definition_index].flags != 0 || !is_forwardable(instructions[definition_index].type) || counter.second->type != instructions[definition_index].type)
+				return false;
+		}
+
+		// The body may not change the loop counters or leave the loop other than by reaching its end
+		for (size_t i = body_begin; i < body_end; ++i)
+		{
+			const instruction &inst = instructions[i];
+
+			switch (inst.kind)
+			{
+			case opcode::leave_block_and_kill:
+			case opcode::leave_block_and_return:
+				return false;
+			case opcode::leave_block_and_branch:
+				if (inst.operands[0] == merge_block || inst.operands[0] == continue_block)
+					return false;
+				break;
+			}
+
+			for (const expression &arg : inst.args)
+				if (!arg.is_constant && (inst.kind != opcode::emit_load || !arg.is_lvalue) &&
+					std::any_of(counters.begin(), counters.end(), [&arg](const auto &counter) { return counter.first == arg.base; }))
+					return false;
+		}
+
+		const size_t body_size = body_end - body_begin;
+		const size_t num_constants = _constants.size();
+
+		// Run the condition and continue blocks at compile-time to find out how many iterations there are and what values the loop counters have in each
+		std::deque<instruction> evaluated;
+		std::unordered_map<id, const instruction *> values;
+		std::vector<std::vector<std::pair<type, constant>>> iterations;
+
+		for (const auto &counter : counters)
+			values[counter.first] = counter.second;
+
+		const auto find_value = [&values](id value) -> const instruction * {
+			const auto it = values.find(value);
+			return it != values.end() ? it->second : nullptr;
+		};
+		const auto evaluate = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				const instruction &inst = instructions[i];
+				if (inst.kind == opcode::emit_constant)
+				{
+					values[inst.result] = &inst;
+				}
+				else if (inst.kind == opcode::emit_store)
+				{
+					if (find_value(inst.operands[0]) == nullptr)
+						return false;
+					values[inst.args[0].base] = find_value(inst.operands[0]);
+				}
+				else
+				{
+					constant data = {};
+					if (!fold(inst, find_value, data))
+						return false;
+
+					instruction &value = evaluated.emplace_back();
+					value.kind = opcode::emit_constant;
+					value.type = inst.type;
+					value.index = static_cast<uint32_t>(_constants.size());
+					_constants.push_back(std::move(data));
+					values[inst.result] = &value;
+				}
+			}
+			return true;
+		};
+
+		bool is_constant_trip_count = false;
+		while (iterations.size() <= max_iterations && (force_unroll || body_size * iterations.size() <= _max_unrolled_size))
+		{
+			const instruction *const condition = evaluate(condition_begin, condition_end) ? find_value(condition_value) : nullptr;
+			if (condition == nullptr || !condition->type.is_scalar())
+				break;
+
+			if (_constants[condition->index].as_uint[0] == 0)
+			{
+				is_constant_trip_count = true;
+				break;
+			}
+
+			std::vector<std::pair<type, constant>> &counter_values = iterations.emplace_back();
+			for (const auto &counter : counters)
+				counter_values.emplace_back(values[counter.first]->type, _constants[values[counter.first]->index]);
+
+			if (!evaluate(continue_begin, continue_end))
+				break;
+		}
+
+		_constants.resize(num_constants);
+
+		if (!is_constant_trip_count || iterations.size() > max_iterations || (!force_unroll && body_size * iterations.size() > _max_unrolled_size))
+			return false;
+
+		// Build the copies of the body before touching the original code, since replacing the loop counters may still fail
+		// They are all put into the block the loop started in (with each copy continuing in the block the previous one ended in), so that no back-end has to join blocks outside of structured control flow
+		std::vector<instruction> unrolled_body;
+		unrolled_body.reserve(body_size * iterations.size());
+
+		id current_block = prev_block;
+		std::unordered_map<id, id> renamed;
+
+		for (size_t k = 0; k < iterations.size(); ++k)
+		{
+			// Every copy but the first needs new IDs for all values and blocks defined in it
+			if (k != 0)
+				for (size_t i = body_begin; i < body_end; ++i)
+					if (instructions[i].result != 0)
+						renamed[instructions[i].result] = make_id();
+
+			renamed[body_block] = current_block;
+
+			for (size_t i = body_begin; i < body_end; ++i)
+			{
+				instruction &inst = unrolled_body.emplace_back(instructions[i]);
+
+				if (inst.kind == opcode::emit_load && inst.args[0].is_lvalue)
+				{
+					if (const auto it = std::find_if(counters.begin(), counters.end(), [&inst](const auto &counter) { return counter.first == inst.args[0].base; }); it != counters.end())
+					{
+						constant data;
+						if (!fold_chain(iterations[k][it - counters.begin()].second, inst.args[0].chain, data))
+						{
+							_constants.resize(num_constants);
+							return false;
+						}
+
+						inst.kind = opcode::emit_constant;
+						inst.index = static_cast<uint32_t>(_constants.size());
+						inst.args.clear();
+						_constants.push_back(std::move(data));
+					}
+				}
+
+				for_each_id(inst, [&renamed](id &value) {
+					if (const auto it = renamed.find(value); it != renamed.end())
+						value = it->second;
+				});
+			}
+
+			// The body may have ended in a different block than it started in (e.g. after a nested loop), in which case the next copy continues there
+			if (last_block != body_block)
+				current_block = renamed.count(last_block) != 0 ? renamed.at(last_block) : last_block;
+		}
+
+		if (std::any_of(unrolled_body.begin(), unrolled_body.end(), [](const instruction &inst) { return inst.kind == opcode::emit_loop; }))
+			has_unrolled_nested_loops = true;
+
+		// Replace everything from the branch into the loop to the loop itself with the copies of the body, which then continue with whatever came after the loop
+		instructions.erase(instructions.begin() + prev_index, instructions.end());
+		instructions.insert(instructions.end(), std::make_move_iterator(unrolled_body.begin()), std::make_move_iterator(unrolled_body.end()));
+
+		replaced_blocks[merge_block] = current_block;
+
+		// None of the blocks the loop was made up of are used anymore, so do not create them either
+		const id removed_blocks[] = { header_block, condition_block, continue_block, body_block, merge_block };
+		for (size_t i = prev_index, num_removed_blocks = 0; i-- > 0 && num_removed_blocks < std::size(removed_blocks);)
+		{
+			if (instructions[i].kind == opcode::create_block && std::find(std::begin(removed_blocks), std::end(removed_blocks), instructions[i].result) != std::end(removed_blocks))
+			{
+				instructions[i].dead = true;
+				num_removed_blocks++;
+			}
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Simplify the recorded instructions before they are passed on to the back-end.
+	/// This propagates copies and values stored to variables, folds constant expressions (including calls to intrinsics), eliminates common subexpressions and finally removes all values that ended up unused.
+	/// Values are only reused within the same basic block, so the result does not depend on how a back-end lays out blocks.
+	/// </summary>
+	void optimize()
+	{
+		// Values that were replaced with an equivalent earlier value
+		std::vector<id> replacements(_next_id);
+		// Index of the instruction that defines each value
+		std::vector<size_t> definitions(_next_id, std::numeric_limits<size_t>::max());
+		// Values that the text back-ends refer to by the name of the variable they were loaded from, so that they change whenever the variable does
+		std::vector<bool> aliases(_next_id);
+
+		const auto resolve = [&replacements](id value) {
+			while (value != 0 && replacements[value] != 0)
+				value = replacements[value];
+			return value;
+		};
+		const auto replace = [&](instruction &inst, id value) {
+			replacements[inst.result] = value;
+			aliases[inst.result] = aliases[value];
+			inst.dead = true;
+		};
+		const auto make_constant = [&](instruction &inst, constant &&data) {
+			if (inst.kind == opcode::emit_load)
+				inst.type = inst.args[0].type;
+
+			inst.kind = opcode::emit_constant;
+			inst.index = static_cast<uint32_t>(_constants.size());
+			inst.operands.clear();
+			inst.args.clear();
+			_constants.push_back(std::move(data));
+
+			aliases[inst.result] = false;
+		};
+		const auto find_constant = [&](id value) -> const instruction * {
+			if (definitions[value] >= _instructions.size())
+				return nullptr;
+			const instruction &definition = _instructions[definitions[value]];
+			return definition.kind == opcode::emit_constant && (definition.type.is_scalar() || definition.type.is_vector()) ? &definition : nullptr;
+		};
+
+		// Values computed in the current block, keyed by the instruction that computed them
+		std::unordered_map<const instruction *, id, value_hash, value_equal> values;
+		// Same as above, but for values that depend on the contents of a variable, so these are forgotten whenever something may write to one
+		std::unordered_map<const instruction *, id, value_hash, value_equal> memory_values;
+		// Values last stored to a variable in the current block
+		std::unordered_map<id, id> stored_values;
+		std::unordered_set<id> global_variables;
+
+		// Variables that are written anywhere, either directly or by passing them to a function
+		std::vector<bool> written_variables(_next_id);
+		for (const instruction &inst : _instructions)
+			for (size_t k = 0; k < inst.args.size(); ++k)
+				if (inst.args[k].is_lvalue && (inst.kind == opcode::emit_call || inst.kind == opcode::emit_call_intrinsic || (inst.kind == opcode::emit_store && k == 0)))
+					written_variables[inst.args[k].base] = true;
+
+		for (size_t i = 0; i < _instructions.size(); ++i)
+		{
+			instruction &inst = _instructions[i];
+
+			if (inst.kind == opcode::emit_switch)
+				inst.operands[0] = resolve(inst.operands[0]);
+			else
+				for (id &operand : inst.operands)
+					operand = resolve(operand);
+
+			for (expression &arg : inst.args)
+			{
+				if (!arg.is_constant)
+					arg.base = resolve(arg.base);
+
+				for (expression::operation &op : arg.chain)
+				{
+					if (op.op != expression::operation::op_dynamic_index)
+						continue;
+
+					op.index = resolve(op.index);
+
+					// Indices that turned out to be constant (e.g. because a loop was unrolled) can be accessed directly
+					if (const instruction *const index = find_constant(op.index); index != nullptr && index->type.is_scalar() &&
+						_constants[index->index].as_uint[0] < (op.from.is_array() ? static_cast<unsigned int>(std::max(op.from.array_length, 0)) : op.from.rows))
+					{
+						op.op = expression::operation::op_constant_index;
+						op.index = _constants[index->index].as_uint[0];
+					}
+				}
+			}
+
+			if (inst.result != 0)
+				definitions[inst.result] = i;
+
+			switch (inst.kind)
+			{
+			case opcode::define_variable:
+				if (inst.flags != 0)
+					global_variables.insert(inst.result);
+				else if (inst.in_block && inst.operands[0] != 0 && is_forwardable(inst.type) && !aliases[inst.operands[0]])
+					stored_values[inst.result] = inst.operands[0];
+				continue;
+			case opcode::emit_store:
+			{
+				const expression &target = inst.args[0];
+				memory_values.clear();
+				if (target.chain.empty() && is_forwardable(target.type) && !aliases[inst.operands[0]])
+					stored_values[target.base] = inst.operands[0];
+				else
+					stored_values.erase(target.base);
+				continue;
+			}
+			case opcode::emit_call:
+				// Functions may write to global variables and output parameters, but not to any other local variables
+				memory_values.clear();
+				for (auto it = stored_values.begin(); it != stored_values.end();)
+				{
+					if (global_variables.find(it->first) != global_variables.end() ||
+						std::any_of(inst.args.begin(), inst.args.end(), [variable = it->first](const expression &arg) { return arg.is_lvalue && arg.base == variable; }))
+						it = stored_values.erase(it);
+					else
+						++it;
+				}
+				continue;
+			case opcode::emit_call_intrinsic:
+				if (!is_pure(inst))
+				{
+					memory_values.clear();
+					stored_values.clear();
+					continue;
+				}
+				break;
+			case opcode::emit_load:
+			case opcode::emit_constant:
+			case opcode::emit_unary_op:
+			case opcode::emit_binary_op:
+			case opcode::emit_ternary_op:
+			case opcode::emit_construct:
+				break;
+			case opcode::create_block:
+				continue;
+			default:
+				// Any change of the current block or function invalidates everything known about values (this includes control flow, which may contain code of other blocks)
+				values.clear();
+				memory_values.clear();
+				stored_values.clear();
+				continue;
+			}
+
+			if (!inst.in_block || inst.kind == opcode::emit_constant)
+				continue;
+
+			if (inst.kind == opcode::emit_load)
+			{
+				expression &arg = inst.args[0];
+
+				if (arg.chain.empty())
+				{
+					// Loading a value without access chain just returns that value
+					if (!arg.is_lvalue)
+					{
+						replace(inst, arg.base);
+						continue;
+					}
+
+					// Loading a variable that was just written returns the written value
+					if (const auto it = stored_values.find(arg.base); it != stored_values.end())
+					{
+						replace(inst, it->second);
+						continue;
+					}
+				}
+				else if (arg.is_lvalue)
+				{
+					// Elements of a variable that was just written can be extracted from the written value directly
+					if (const auto it = stored_values.find(arg.base); it != stored_values.end() &&
+						std::all_of(arg.chain.begin(), arg.chain.end(), [](const expression::operation &op) {
+							return op.op == expression::operation::op_cast || op.op == expression::operation::op_swizzle || op.op == expression::operation::op_constant_index; }))
+					{
+						// The text back-ends cannot apply an access chain to a literal, so only do this for constants if the result can be folded too
+						constant data;
+						if (find_constant(it->second) == nullptr || fold_chain(_constants[find_constant(it->second)->index], arg.chain, data))
+						{
+							arg.base = it->second;
+							arg.is_lvalue = false;
+						}
+					}
+				}
+
+				// Local variables that are never written keep the constant they were initialized with (like the temporary variables the parser creates to index into constant arrays)
+				if (arg.is_lvalue && !written_variables[arg.base] && definitions[arg.base] < i && is_forwardable(inst.type))
+				{
+					const instruction &variable = _instructions[definitions[arg.base]];
+					if (constant data; variable.kind == opcode::define_variable && variable.flags == 0 && variable.operands[0] != 0 && definitions[variable.operands[0]] < i &&
+						_instructions[definitions[variable.operands[0]]].kind == opcode::emit_constant &&
+						fold_chain(_constants[_instructions[definitions[variable.operands[0]]].index], arg.chain, data))
+					{
+						make_constant(inst, std::move(data));
+						continue;
+					}
+				}
+
+				aliases[inst.result] = arg.is_lvalue || aliases[arg.base] ||
+					std::any_of(arg.chain.begin(), arg.chain.end(), [&aliases](const expression::operation &op) {
+						return op.op == expression::operation::op_dynamic_index && aliases[op.index]; });
+			}
+			else if (inst.kind == opcode::emit_ternary_op)
+			{
+				// Choose the value directly if the condition is known
+				if (const instruction *const condition = find_constant(inst.operands[0]); condition != nullptr && condition->type.is_scalar())
+				{
+					const id value = inst.operands[_constants[condition->index].as_uint[0] != 0 ? 1 : 2];
+					if (!aliases[value])
+					{
+						replace(inst, value);
+						continue;
+					}
+				}
+			}
+
+			if (constant data = {}; fold(inst, find_constant, data))
+			{
+				make_constant(inst, std::move(data));
+				continue;
+			}
+
+			// Values that depend on the contents of a variable are only the same until the next write to memory
+			const bool depends_on_memory =
+				std::any_of(inst.operands.begin(), inst.operands.end(), [&aliases](id value) { return aliases[value]; }) ||
+				std::any_of(inst.args.begin(), inst.args.end(), [&](const expression &arg) {
+					return (arg.is_lvalue && _read_only_variables.find(arg.base) == _read_only_variables.end()) || (!arg.is_constant && aliases[arg.base]) ||
+						std::any_of(arg.chain.begin(), arg.chain.end(), [&aliases](const expression::operation &op) {
+							return op.op == expression::operation::op_dynamic_index && aliases[op.index]; });
+				});
+
+			auto &table = depends_on_memory ? memory_values : values;
+			if (const auto insert = table.emplace(&inst, inst.result); !insert.second)
+				replace(inst, insert.first->second);
+		}
+
+		// Remove values that are not used by anything, going backwards so that the inputs of removed values can be removed as well
+		std::vector<uint32_t> uses(_next_id);
+
+		// Local variables that are never read do not need to be written either
+		std::vector<bool> read_variables(_next_id);
+
+		for (const instruction &inst : _instructions)
+		{
+			if (inst.dead)
+				continue;
+
+			for_each_use(inst, [&uses](id value) { uses[value]++; });
+
+			if (inst.kind != opcode::emit_store)
+				for (const expression &arg : inst.args)
+					if (arg.is_lvalue)
+						read_variables[arg.base] = true;
+		}
+
+		for (size_t i = _instructions.size(); i-- > 0;)
+		{
+			instruction &inst = _instructions[i];
+			if (inst.dead)
+				continue;
+
+			if (inst.kind == opcode::emit_store)
+			{
+				const id variable = inst.args[0].base;
+				if (!read_variables[variable] && definitions[variable] < i && _instructions[definitions[variable]].kind == opcode::define_variable && _instructions[definitions[variable]].in_block)
+				{
+					inst.dead = true;
+					for_each_use(inst, [&uses](id value) { uses[value]--; });
+				}
+				continue;
+			}
+
+			if (!inst.in_block || inst.result == 0 || uses[inst.result] != 0)
+				continue;
+
+			switch (inst.kind)
+			{
+			case opcode::emit_call_intrinsic:
+				if (!is_pure(inst))
+					continue;
+				[[fallthrough]];
+			case opcode::define_variable: // Only local variables are defined inside a block, so these can be removed as well
+			case opcode::emit_load:
+			case opcode::emit_constant:
+			case opcode::emit_unary_op:
+			case opcode::emit_binary_op:
+			case opcode::emit_ternary_op:
+			case opcode::emit_construct:
+				inst.dead = true;
+				for_each_use(inst, [&uses](id value) { uses[value]--; });
+				break;
+			}
+		}
+	}
+
+	/// <summary>
+	/// Call the specified function for every ID an instruction defines or refers to (values, variables and blocks), so that they can be changed.
+	/// </summary>
+	template <typename F>
+	static void for_each_id(instruction &inst, const F &callback)
+	{
+		if (inst.result != 0)
+			callback(inst.result);
+		for (size_t k = 0; k < inst.operands.size(); ++k)
+			// The case literals of a switch are not IDs
+			if (inst.kind != opcode::emit_switch || k < 3 || (k - 3) % 2 != 0)
+				callback(inst.operands[k]);
+		for (expression &arg : inst.args)
+		{
+			if (!arg.is_constant)
+				callback(arg.base);
+			for (expression::operation &op : arg.chain)
+				if (op.op == expression::operation::op_dynamic_index)
+					callback(op.index);
+		}
+	}
+	/// <summary>
+	/// Call the specified function for every value (or variable) an instruction uses as input.
+	/// </summary>
+	template <typename F>
+	static void for_each_use(const instruction &inst, const F &callback)
+	{
+		for (size_t k = 0; k < (inst.kind == opcode::emit_switch ? 1 : inst.operands.size()); ++k)
+			callback(inst.operands[k]);
+		for (const expression &arg : inst.args)
+		{
+			if (!arg.is_constant)
+				callback(arg.base);
+			for (const expression::operation &op : arg.chain)
+				if (op.op == expression::operation::op_dynamic_index)
+					callback(op.index);
+		}
+	}
+
+	static bool is_forwardable(const type &type)
+	{
+		return (type.is_scalar() || type.is_vector()) && !type.is_array();
+	}
+	static bool is_pure(const instruction &inst)
+	{
+		return !inst.type.is_void() && std::none_of(inst.args.begin(), inst.args.end(), [](const expression &arg) { return arg.is_lvalue; });
+	}
+	static bool is_value(const instruction &inst)
+	{
+		switch (inst.kind)
+		{
+		case opcode::emit_call_intrinsic:
+			return is_pure(inst);
+		case opcode::emit_load:
+		case opcode::emit_constant:
+		case opcode::emit_unary_op:
+		case opcode::emit_binary_op:
+		case opcode::emit_ternary_op:
+		case opcode::emit_construct:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Hash and comparison of instructions by the value they compute, so that instructions computing the same value from the same inputs can be found
+	struct value_hash
+	{
+		size_t operator()(const instruction *inst) const
+		{
+			size_t result = static_cast<size_t>(inst->kind);
+			result = result * 31 + static_cast<size_t>(inst->op);
+			result = result * 31 + inst->index;
+			result = result * 31 + std::hash<type>()(inst->type);
+			for (const id operand : inst->operands)
+				result = result * 31 + operand;
+			for (const expression &arg : inst->args)
+			{
+				result = result * 31 + arg.base;
+				for (const expression::operation &op : arg.chain)
+					result = result * 31 + op.op * 7 + op.index;
+			}
+			return result;
+		}
+	};
+	struct value_equal
+	{
+		bool operator()(const instruction *lhs, const instruction *rhs) const
+		{
+			return lhs->kind == rhs->kind && lhs->op == rhs->op && lhs->index == rhs->index &&
+				lhs->type == rhs->type && lhs->type.qualifiers == rhs->type.qualifiers && lhs->operand_type == rhs->operand_type && lhs->operands == rhs->operands &&
+				std::equal(lhs->args.begin(), lhs->args.end(), rhs->args.begin(), rhs->args.end(), [](const expression &a, const expression &b) {
+					return a.base == b.base && a.is_lvalue == b.is_lvalue && a.is_constant == b.is_constant && a.type == b.type &&
+						(!a.is_constant || std::memcmp(a.constant.as_uint, b.constant.as_uint, sizeof(a.constant.as_uint)) == 0) &&
+						std::equal(a.chain.begin(), a.chain.end(), b.chain.begin(), b.chain.end(), [](const expression::operation &x, const expression::operation &y) {
+							return x.op == y.op && x.from == y.from && x.to == y.to && x.index == y.index && std::memcmp(x.swizzle, y.swizzle, sizeof(x.swizzle)) == 0;
+						});
+				});
+		}
+	};
+
+	/// <summary>
+	/// Try to evaluate a value at compile-time.
+	/// </summary>
+	/// <param name="find_constant">Function that returns the instruction defining a scalar or vector constant for an ID, or <c>nullptr</c> if it is not one.</param>
+	/// <param name="data">The resulting constant value.</param>
+	/// <returns><c>true</c> if the value is constant, <c>false</c> otherwise.</returns>
+	template <typename F>
+	bool fold(const instruction &inst, const F &find_constant, constant &data) const
+	{
+		if (!inst.type.is_scalar() && !inst.type.is_vector())
+			return false;
+
+		std::vector<const instruction *> inputs;
+		for (const id operand : inst.operands)
+			if (inputs.emplace_back(find_constant(operand)) == nullptr)
+				return false;
+		for (const expression &arg : inst.args)
+			if (arg.is_constant || (!arg.is_lvalue && inst.kind != opcode::emit_load && !arg.chain.empty()) || inputs.emplace_back(find_constant(arg.base)) == nullptr)
+				return false;
+
+		switch (inst.kind)
+		{
+		case opcode::emit_load:
+			return fold_chain(_constants[inputs[0]->index], inst.args[0].chain, data);
+		case opcode::emit_unary_op:
+		{
+			if (inst.op == tokenid::exclaim ? !inst.type.is_boolean() : inst.op == tokenid::tilde ? !inst.type.is_integral() || inst.type.is_boolean() : inst.op != tokenid::minus)
+				return false;
+
+			expression exp;
+			exp.reset_to_rvalue_constant(inst.loc, _constants[inputs[0]->index], inst.type);
+			if (!exp.evaluate_constant_expression(inst.op))
+				return false;
+			data = exp.constant;
+			return true;
+		}
+		case opcode::emit_binary_op:
+		{
+			const constant &rhs = _constants[inputs[1]->index];
+
+			// Increments, decrements and compound assignments are emitted with their own operator, but compute the same as the plain one
+			tokenid op = inst.op;
+			switch (op)
+			{
+			case tokenid::plus_plus:
+			case tokenid::plus_equal:
+				op = tokenid::plus;
+				break;
+			case tokenid::minus_minus:
+			case tokenid::minus_equal:
+				op = tokenid::minus;
+				break;
+			case tokenid::star_equal:
+				op = tokenid::star;
+				break;
+			case tokenid::slash_equal:
+				op = tokenid::slash;
+				break;
+			case tokenid::percent_equal:
+				op = tokenid::percent;
+				break;
+			case tokenid::ampersand_equal:
+				op = tokenid::ampersand;
+				break;
+			case tokenid::pipe_equal:
+				op = tokenid::pipe;
+				break;
+			case tokenid::caret_equal:
+				op = tokenid::caret;
+				break;
+			case tokenid::less_less_equal:
+				op = tokenid::less_less;
+				break;
+			case tokenid::greater_greater_equal:
+				op = tokenid::greater_greater;
+				break;
+			}
+
+			switch (op)
+			{
+			case tokenid::less_less:
+			case tokenid::greater_greater:
+				// Shifting by the width of the type or more is undefined, so leave that to the hardware
+				for (unsigned int i = 0; i < inst.operand_type.components(); ++i)
+					if (rhs.as_uint[i] >= 32)
+						return false;
+				break;
+			case tokenid::slash:
+			case tokenid::percent:
+				// So is dividing the smallest integer by minus one
+				if (inst.operand_type.is_integral() && inst.operand_type.is_signed())
+					for (unsigned int i = 0; i < inst.operand_type.components(); ++i)
+						if (rhs.as_int[i] == -1)
+							return false;
+				break;
+			case tokenid::star:
+			case tokenid::plus:
+			case tokenid::minus:
+			case tokenid::ampersand:
+			case tokenid::pipe:
+			case tokenid::caret:
+			case tokenid::less:
+			case tokenid::less_equal:
+			case tokenid::greater:
+			case tokenid::greater_equal:
+			case tokenid::equal_equal:
+			case tokenid::exclaim_equal:
+			case tokenid::ampersand_ampersand:
+			case tokenid::pipe_pipe:
+				break;
+			default:
+				return false;
+			}
+
+			expression exp;
+			exp.reset_to_rvalue_constant(inst.loc, _constants[inputs[0]->index], inst.operand_type);
+			if (!exp.evaluate_constant_expression(op, rhs) || exp.type.base != inst.type.base || exp.type.components() != inst.type.components())
+				return false;
+			data = exp.constant;
+			return true;
+		}
+		case opcode::emit_ternary_op:
+		{
+			const bool is_scalar_condition = inputs[0]->type.is_scalar();
+			for (unsigned int i = 0; i < inst.type.components(); ++i)
+				data.as_uint[i] = (_constants[inputs[0]->index].as_uint[is_scalar_condition ? 0 : i] != 0 ? _constants[inputs[1]->index] : _constants[inputs[2]->index]).as_uint[i];
+			return true;
+		}
+		case opcode::emit_construct:
+			if (inputs.size() != inst.type.components())
+				return false;
+			for (size_t i = 0; i < inputs.size(); ++i)
+			{
+				if (inputs[i]->type.base != inst.type.base || !inputs[i]->type.is_scalar())
+					return false;
+				data.as_uint[i] = _constants[inputs[i]->index].as_uint[0];
+			}
+			return true;
+		case opcode::emit_call_intrinsic:
+		{
+			// The parser already evaluates calls with constant arguments, but arguments may only have become constant through forwarding here
+			std::vector<expression> args(inputs.size());
+			for (size_t i = 0; i < inputs.size(); ++i)
+				args[i].reset_to_rvalue_constant(inst.loc, _constants[inputs[i]->index], inputs[i]->type);
+
+			expression exp;
+			if (!exp.evaluate_constant_intrinsic(inst.loc, inst.index, inst.type, args))
+				return false;
+			data = std::move(exp.constant);
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	/// <summary>
+	/// Apply an access chain made up of casts, swizzles and indices into vectors to a scalar or vector constant.
+	/// </summary>
+	static bool fold_chain(const constant &value, const std::vector<expression::operation> &chain, constant &data)
+	{
+		data = value;
+
+		for (const expression::operation &op : chain)
+		{
+			// Elements of constant arrays are constants themselves
+			if (op.op == expression::operation::op_constant_index && op.from.is_array())
+			{
+				if (op.index >= data.array_data.size())
+					return false;
+				data = constant(data.array_data[op.index]);
+				continue;
+			}
+
+			if ((!op.from.is_scalar() && !op.from.is_vector()) || (!op.to.is_scalar() && !op.to.is_vector()))
+				return false;
+
+			constant prev = data;
+
+			switch (op.op)
+			{
+			case expression::operation::op_cast:
+				if (op.from.rows != op.to.rows)
+					return false;
+				for (unsigned int i = 0; i < op.to.rows; ++i)
+				{
+					if (op.to.is_boolean())
+						data.as_uint[i] = op.from.is_floating_point() ? prev.as_float[i] != 0.0f : prev.as_uint[i] != 0;
+					else if (op.to.is_floating_point())
+						data.as_float[i] = op.from.is_floating_point() ? prev.as_float[i] : op.from.is_signed() ? static_cast<float>(prev.as_int[i]) : static_cast<float>(prev.as_uint[i]);
+					else if (op.from.is_floating_point())
+					{
+						// Converting a float that is out of range of the integer type is undefined
+						if (!(op.to.is_signed() ? prev.as_float[i] > -2147483904.0f && prev.as_float[i] < 2147483648.0f : prev.as_float[i] > -1.0f && prev.as_float[i] < 4294967296.0f))
+							return false;
+						if (op.to.is_signed())
+							data.as_int[i] = static_cast<int32_t>(prev.as_float[i]);
+						else
+							data.as_uint[i] = static_cast<uint32_t>(prev.as_float[i]);
+					}
+				}
+				break;
+			case expression::operation::op_swizzle:
+				for (unsigned int i = 0; i < op.to.rows; ++i)
+					data.as_uint[i] = prev.as_uint[op.swizzle[i]];
+				break;
+			case expression::operation::op_constant_index:
+				data.as_uint[0] = prev.as_uint[op.index];
+				break;
+			default:
+				return false;
+			}
+
+			for (unsigned int i = op.to.rows; i < 16; ++i)
+				data.as_uint[i] = 0;
+		}
+
+		return true;
+	}
+
+	instruction &add_instruction(opcode kind, id result = 0)
+	{
+		instruction &inst = _instructions.emplace_back();
+		inst.kind = kind;
+		inst.in_block = is_in_block();
+		inst.result = result;
+		return inst;
+	}
+
+	id   define_struct(const location &loc, struct_info &info) override
+	{
+		info.definition = make_id();
+
+		instruction &inst = add_instruction(opcode::define_struct, info.definition);
+		inst.loc = loc;
+		inst.index = static_cast<uint32_t>(_structs.size());
+
+		_structs.push_back(info);
+
+		return info.definition;
+	}
+	id   define_texture(const location &loc, texture_info &info) override
+	{
+		info.id = make_id();
+
+		instruction &inst = add_instruction(opcode::define_texture, info.id);
+		inst.loc = loc;
+		inst.index = static_cast<uint32_t>(_module.textures.size());
+
+		_module.textures.push_back(info);
+
+		return info.id;
+	}
+	id   define_sampler(const location &loc, sampler_info &info) override
+	{
+		info.id = make_id();
+
+		instruction &inst = add_instruction(opcode::define_sampler, info.id);
+		inst.loc = loc;
+		inst.index = static_cast<uint32_t>(_module.samplers.size());
+
+		_module.samplers.push_back(info);
+		_read_only_variables.insert(info.id);
+
+		return info.id;
+	}
+	id   define_uniform(const location &loc, uniform_info &info) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::define_uniform, res);
+		inst.loc = loc;
+		inst.index = static_cast<uint32_t>(_module.uniforms.size());
+
+		_module.uniforms.push_back(info);
+		_read_only_variables.insert(res);
+
+		return res;
+	}
+	id   define_variable(const location &loc, const type &type, std::string name, bool global, id initializer_value) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::define_variable, res);
+		inst.loc = loc;
+		inst.type = type;
+		inst.name = std::move(name);
+		inst.flags = global;
+		inst.operands = { initializer_value };
+
+		return res;
+	}
+	id   define_function(const location &loc, function_info &info) override
+	{
+		info.definition = make_id();
+
+		for (struct_member_info &param : info.parameter_list)
+			param.definition = make_id();
+
+		instruction &inst = add_instruction(opcode::define_function, info.definition);
+		inst.loc = loc;
+		inst.index = static_cast<uint32_t>(_functions.size());
+
+		_functions.push_back(std::make_unique<function_info>(info));
+
+		return info.definition;
+	}
+
+	void define_entry_point(const function_info &func, bool is_ps) override
+	{
+		instruction &inst = add_instruction(opcode::define_entry_point);
+		inst.index = func.definition;
+		inst.flags = is_ps;
+	}
+
+	id   emit_load(const expression &exp, bool force_new_id) override
+	{
+		// All back-ends turn loads of constants into plain constants
+		if (exp.is_constant)
+			return emit_constant(exp.type, exp.constant);
+
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_load, res);
+		inst.loc = exp.location;
+		inst.type = exp.type;
+		inst.flags = force_new_id;
+		inst.args = { exp };
+
+		return res;
+	}
+	void emit_store(const expression &exp, id value) override
+	{
+		instruction &inst = add_instruction(opcode::emit_store);
+		inst.loc = exp.location;
+		inst.operands = { value };
+		inst.args = { exp };
+	}
+
+	id   emit_constant(const type &type, const constant &data) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_constant, res);
+		inst.type = type;
+		inst.index = static_cast<uint32_t>(_constants.size());
+
+		_constants.push_back(data);
+
+		return res;
+	}
+
+	id   emit_unary_op(const location &loc, tokenid op, const type &type, id val) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_unary_op, res);
+		inst.loc = loc;
+		inst.op = op;
+		inst.type = type;
+		inst.operands = { val };
+
+		return res;
+	}
+	id   emit_binary_op(const location &loc, tokenid op, const type &res_type, const type &type, id lhs, id rhs) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_binary_op, res);
+		inst.loc = loc;
+		inst.op = op;
+		inst.type = res_type;
+		inst.operand_type = type;
+		inst.operands = { lhs, rhs };
+
+		return res;
+	}
+	id   emit_ternary_op(const location &loc, tokenid op, const type &type, id condition, id true_value, id false_value) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_ternary_op, res);
+		inst.loc = loc;
+		inst.op = op;
+		inst.type = type;
+		inst.operands = { condition, true_value, false_value };
+
+		return res;
+	}
+	id   emit_call(const location &loc, id function, const type &res_type, const std::vector<expression> &args) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_call, res);
+		inst.loc = loc;
+		inst.index = function;
+		inst.type = res_type;
+		inst.args = args;
+
+		return res;
+	}
+	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::vector<expression> &args) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_call_intrinsic, res);
+		inst.loc = loc;
+		inst.index = intrinsic;
+		inst.type = res_type;
+		inst.args = args;
+
+		return res;
+	}
+	id   emit_construct(const location &loc, const type &type, const std::vector<expression> &args) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_construct, res);
+		inst.loc = loc;
+		inst.type = type;
+		inst.args = args;
+
+		return res;
+	}
+
+	void emit_if(const location &loc, id condition_value, id condition_block, id true_statement_block, id false_statement_block, unsigned int flags) override
+	{
+		instruction &inst = add_instruction(opcode::emit_if);
+		inst.loc = loc;
+		inst.flags = flags;
+		inst.operands = { condition_value, condition_block, true_statement_block, false_statement_block };
+	}
+	id   emit_phi(const location &loc, id condition_value, id condition_block, id true_value, id true_statement_block, id false_value, id false_statement_block, const type &type) override
+	{
+		const id res = make_id();
+
+		instruction &inst = add_instruction(opcode::emit_phi, res);
+		inst.loc = loc;
+		inst.type = type;
+		inst.operands = { condition_value, condition_block, true_value, true_statement_block, false_value, false_statement_block };
+
+		return res;
+	}
+	void emit_loop(const location &loc, id condition_value, id prev_block, id header_block, id condition_block, id loop_block, id continue_block, unsigned int flags) override
+	{
+		instruction &inst = add_instruction(opcode::emit_loop);
+		inst.loc = loc;
+		inst.flags = flags;
+		inst.operands = { condition_value, prev_block, header_block, condition_block, loop_block, continue_block };
+	}
+	void emit_switch(const location &loc, id selector_value, id selector_block, id default_label, const std::vector<id> &case_literal_and_labels, unsigned int flags) override
+	{
+		instruction &inst = add_instruction(opcode::emit_switch);
+		inst.loc = loc;
+		inst.flags = flags;
+		inst.operands = { selector_value, selector_block, default_label };
+		inst.operands.insert(inst.operands.end(), case_literal_and_labels.begin(), case_literal_and_labels.end());
+	}
+
+	id   create_block() override
+	{
+		const id res = make_id();
+
+		add_instruction(opcode::create_block, res);
+
+		return res;
+	}
+	id   set_block(id id) override
+	{
+		add_instruction(opcode::set_block).operands = { id };
+
+		_last_block = _current_block;
+		_current_block = id;
+
+		return _last_block;
+	}
+	void enter_block(id id) override
+	{
+		add_instruction(opcode::enter_block).operands = { id };
+
+		_current_block = id;
+	}
+	id   leave_block_and_kill() override
+	{
+		add_instruction(opcode::leave_block_and_kill);
+
+		if (!is_in_block())
+			return 0;
+
+		return leave_block();
+	}
+	id   leave_block_and_return(id value) override
+	{
+		add_instruction(opcode::leave_block_and_return).operands = { value };
+
+		if (!is_in_block())
+			return 0;
+
+		return leave_block();
+	}
+	id   leave_block_and_switch(id value, id default_target) override
+	{
+		add_instruction(opcode::leave_block_and_switch).operands = { value, default_target };
+
+		if (!is_in_block())
+			return _last_block;
+
+		return leave_block();
+	}
+	id   leave_block_and_branch(id target, unsigned int loop_flow) override
+	{
+		instruction &inst = add_instruction(opcode::leave_block_and_branch);
+		inst.flags = loop_flow;
+		inst.operands = { target };
+
+		if (!is_in_block())
+			return _last_block;
+
+		return leave_block();
+	}
+	id   leave_block_and_branch_conditional(id condition, id true_target, id false_target) override
+	{
+		add_instruction(opcode::leave_block_and_branch_conditional).operands = { condition, true_target, false_target };
+
+		if (!is_in_block())
+			return _last_block;
+
+		return leave_block();
+	}
+	void leave_function() override
+	{
+		add_instruction(opcode::leave_function);
+	}
+
+	id   leave_block()
+	{
+		_last_block = _current_block;
+		_current_block = 0;
+
+		return _last_block;
+	}
+};
+
+codegen *reshadefx::create_codegen_ir(std::vector<codegen *> backends, bool optimize, unsigned int max_unrolled_size)
+{
+	return new codegen_ir(std::move(backends), optimize, max_unrolled_size);
+}
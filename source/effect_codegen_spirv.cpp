@@ -96,18 +96,82 @@ struct spirv_instruction
 };
 
 /// <summary>
-/// A list of instructions forming a basic block in the SPIR-V module
+/// A list of instructions forming a basic block in the SPIR-V module, encoded as a contiguous stream of words
 /// </summary>
 struct spirv_basic_block
 {
-	std::vector<spirv_instruction> instructions;
+	std::vector<uint32_t> words;
+	// The most recently added instruction is kept decoded until the next one is added, so that it can still be modified or removed again
+	spirv_instruction last;
+	bool has_last = false;
+
+	bool empty() const { return words.empty() && !has_last; }
+
+	/// <summary>
+	/// Add a new instruction to the end of this basic block.
+	/// The returned reference is only valid until the next instruction is added to this block.
+	/// </summary>
+	spirv_instruction &add_instruction(spv::Op op)
+	{
+		flush();
+		last.op = op;
+		last.type = 0;
+		last.result = 0;
+		last.operands.clear(); // Keep operand storage around for reuse
+		has_last = true;
+		return last;
+	}
+	void add_instruction(spirv_instruction &&instruction)
+	{
+		flush();
+		last = std::move(instruction);
+		has_last = true;
+	}
 
 	/// <summary>
-	/// Append another basic block the end of this one.
+	/// Remove the last instruction from this basic block and return it.
 	/// </summary>
-	void append(const spirv_basic_block &block)
+	spirv_instruction pop_instruction()
 	{
-		instructions.insert(instructions.end(), block.instructions.begin(), block.instructions.end());
+		assert(has_last);
+		has_last = false;
+		return std::move(last);
+	}
+
+	/// <summary>
+	/// Encode the pending last instruction into the word stream.
+	/// </summary>
+	void flush()
+	{
+		if (has_last)
+			last.write(words), has_last = false;
+	}
+
+	/// <summary>
+	/// Append another basic block the end of this one. The other block is left empty.
+	/// </summary>
+	void append(spirv_basic_block &&block)
+	{
+		flush();
+		block.flush();
+
+		// Take over the word stream directly if this block is still empty, which is the common case when splicing the block preceding a control flow construct
+		if (words.empty())
+			words.swap(block.words);
+		else
+			words.insert(words.end(), block.words.begin(), block.words.end());
+
+		block.words.clear();
+	}
+
+	/// <summary>
+	/// Write this basic block to a SPIR-V module.
+	/// </summary>
+	/// <param name="output">The output stream to append the words of this block to.</param>
+	void write(std::vector<uint32_t> &output)
+	{
+		flush();
+		output.insert(output.end(), words.begin(), words.end());
 	}
 };
 
@@ -126,7 +190,53 @@ private:
 		type type;
 		spv::StorageClass storage;
 		bool is_ptr;
-		spv::Id id;
+
+		friend bool operator==(const type_lookup &lhs, const type_lookup &rhs)
+		{
+			return lhs.type == rhs.type && lhs.storage == rhs.storage && lhs.is_ptr == rhs.is_ptr;
+		}
+
+		struct hash
+		{
+			size_t operator()(const type_lookup &info) const
+			{
+				return (std::hash<reshadefx::type>()(info.type) * 31 + info.storage) * 2 + info.is_ptr;
+			}
+		};
+	};
+	struct constant_lookup
+	{
+		type type;
+		constant data;
+
+		// Only the components that are actually used by the type are compared, since the rest of the constant data is undefined
+		friend bool operator==(const constant_lookup &lhs, const constant_lookup &rhs)
+		{
+			if (!(lhs.type == rhs.type) || lhs.data.array_data.size() != rhs.data.array_data.size())
+				return false;
+			const unsigned int num_components = lhs.type.components();
+			if (std::memcmp(&lhs.data.as_uint[0], &rhs.data.as_uint[0], sizeof(uint32_t) * num_components) != 0)
+				return false;
+			for (size_t i = 0; i < lhs.data.array_data.size(); ++i)
+				if (std::memcmp(&lhs.data.array_data[i].as_uint[0], &rhs.data.array_data[i].as_uint[0], sizeof(uint32_t) * num_components) != 0)
+					return false;
+			return true;
+		}
+
+		struct hash
+		{
+			size_t operator()(const constant_lookup &info) const
+			{
+				size_t result = std::hash<reshadefx::type>()(info.type);
+				const unsigned int num_components = info.type.components();
+				for (unsigned int i = 0; i < num_components; ++i)
+					result = result * 31 + info.data.as_uint[i];
+				for (const constant &element : info.data.array_data)
+					for (unsigned int i = 0; i < num_components; ++i)
+						result = result * 31 + element.as_uint[i];
+				return result;
+			}
+		};
 	};
 	struct function_blocks
 	{
@@ -135,6 +245,8 @@ private:
 		spirv_basic_block definition;
 		type return_type;
 		std::vector<type> param_types;
+		// Values in this function that are decorated with 'RelaxedPrecision', so that the decorations can be removed together with the function
+		std::vector<spv::Id> relaxed_precision_values;
 
 		friend bool operator==(const function_blocks &lhs, const function_blocks &rhs)
 		{
@@ -145,6 +257,18 @@ private:
 					return false;
 			return lhs.return_type == rhs.return_type;
 		}
+
+		// Only the function signature is hashed, to match the comparison operator above
+		struct hash
+		{
+			size_t operator()(const function_blocks &info) const
+			{
+				size_t result = std::hash<reshadefx::type>()(info.return_type);
+				for (const type &param_type : info.param_types)
+					result = result * 31 + std::hash<reshadefx::type>()(param_type);
+				return result;
+			}
+		};
 	};
 
 	spirv_basic_block _entries;
@@ -156,14 +280,15 @@ private:
 	spirv_basic_block _variables;
 
 	std::unordered_set<spv::Capability> _capabilities;
-	std::vector<type_lookup> _type_lookup;
-	std::vector<std::pair<function_blocks, spv::Id>> _function_type_lookup;
-	std::vector<std::tuple<type, constant, spv::Id>> _constant_lookup;
+	std::unordered_map<type_lookup, spv::Id, type_lookup::hash> _type_lookup;
+	std::unordered_map<function_blocks, spv::Id, function_blocks::hash> _function_type_lookup;
+	std::unordered_map<constant_lookup, spv::Id, constant_lookup::hash> _constant_lookup;
 	std::unordered_map<std::string, uint32_t> _semantic_to_location;
-	std::unordered_map<std::string, spv::Id> _string_lookup;
+	std::unordered_map<uint32_t, spv::Id> _string_lookup;
 	std::unordered_map<spv::Id, spv::StorageClass> _storage_lookup;
 	uint32_t _current_semantic_location = 10;
 	std::unordered_set<spv::Id> _spec_constants;
+	std::unordered_set<spv::Id> _removable_variables;
 
 	std::vector<function_blocks> _functions2;
 	std::unordered_map<id, spirv_basic_block> _block_data;
@@ -180,13 +305,13 @@ private:
 
 	inline void add_location(const location &loc, spirv_basic_block &block)
 	{
-		if (loc.source.empty() || !_debug_info)
+		if (loc.source == 0 || !_debug_info)
 			return;
 
 		spv::Id file = _string_lookup[loc.source];
 		if (file == 0) {
 			file = add_instruction(spv::OpString, 0, _debug_a)
-				.add_string(loc.source.c_str())
+				.add_string(location::source_name(loc.source).c_str())
 				.result;
 			_string_lookup[loc.source] = file;
 		}
@@ -216,7 +341,19 @@ private:
 	}
 	inline spirv_instruction &add_instruction_without_result(spv::Op op, spirv_basic_block &block)
 	{
-		return block.instructions.emplace_back(op);
+		return block.add_instruction(op);
+	}
+
+	/// <summary>
+	/// Move the contents of the specified basic block to the end of the current one and release it.
+	/// </summary>
+	void append_block(id block)
+	{
+		if (const auto it = _block_data.find(block); it != _block_data.end())
+		{
+			_current_block_data->append(std::move(it->second));
+			_block_data.erase(it);
+		}
 	}
 
 	void write_result(module &module) override
@@ -232,6 +369,63 @@ private:
 
 		module = std::move(_module);
 
+		// Leave out all functions and global variables that no entry point can reach, together with their names and decorations
+		const std::unordered_set<id> referenced = find_referenced();
+
+		std::vector<bool> function_used(_functions.size());
+		std::unordered_set<spv::Id> unused_ids;
+		for (size_t i = 0; i < _functions.size(); ++i)
+		{
+			function_used[i] = referenced.find(_functions[i]->definition) != referenced.end();
+			if (function_used[i])
+				continue;
+
+			unused_ids.insert(_functions[i]->definition);
+			for (const struct_member_info &param : _functions[i]->parameter_list)
+				unused_ids.insert(param.definition);
+
+			// Local variables of the function may have names as well
+			spirv_basic_block &variables = _functions2[i].variables;
+			variables.flush();
+			for (size_t offset = 0; offset < variables.words.size(); offset += variables.words[offset] >> spv::WordCountShift)
+				if ((variables.words[offset] & spv::OpCodeMask) == spv::OpVariable)
+					unused_ids.insert(variables.words[offset + 2]);
+
+			unused_ids.insert(_functions2[i].relaxed_precision_values.begin(), _functions2[i].relaxed_precision_values.end());
+		}
+		for (const spv::Id variable : _removable_variables)
+			if (referenced.find(variable) == referenced.end())
+				unused_ids.insert(variable);
+
+		if (!unused_ids.empty())
+			for (spirv_basic_block *block : { &_debug_b, &_annotations, &_variables })
+				remove_instructions(*block, unused_ids);
+
+		// Reserve space for all words up front, so that the module is serialized in a single pass without reallocations
+		size_t num_words = 64; // Header, capabilities, extensions and memory model
+		for (spirv_basic_block *block : { &_entries, &_execution_modes, &_debug_a, &_debug_b, &_annotations, &_types_and_constants, &_variables })
+			block->flush(), num_words += block->words.size();
+		for (size_t i = 0; i < _functions2.size(); ++i)
+		{
+			function_blocks &function = _functions2[i];
+			function.declaration.flush();
+			function.variables.flush();
+			function.definition.flush();
+			const size_t function_words = function.declaration.words.size() + function.variables.words.size() + function.definition.words.size();
+
+			if (function_used[i])
+			{
+				num_words += function_words;
+			}
+			else
+			{
+				_removed_code_size += function_words * sizeof(uint32_t);
+				_num_removed_functions++;
+			}
+		}
+
+		module.spirv.reserve(num_words);
+
 		// Write SPIRV header info
 		module.spirv.push_back(spv::MagicNumber);
 		module.spirv.push_back(spv::Version);
@@ -268,57 +462,96 @@ private:
 			.write(module.spirv);
 
 		// All entry point declarations
-		for (const auto &node : _entries.instructions)
-			node.write(module.spirv);
+		_entries.write(module.spirv);
 
 		// All execution mode declarations
-		for (const auto &node : _execution_modes.instructions)
-			node.write(module.spirv);
+		_execution_modes.write(module.spirv);
 
 		if (_debug_info)
 		{
 			// All debug instructions
-			for (const auto &node : _debug_a.instructions)
-				node.write(module.spirv);
-			for (const auto &node : _debug_b.instructions)
-				node.write(module.spirv);
+			_debug_a.write(module.spirv);
+			_debug_b.write(module.spirv);
 		}
 
 		// All annotation instructions
-		for (const auto &node : _annotations.instructions)
-			node.write(module.spirv);
+		_annotations.write(module.spirv);
 
 		// All type declarations
-		for (const auto &node : _types_and_constants.instructions)
-			node.write(module.spirv);
-		for (const auto &node : _variables.instructions)
-			node.write(module.spirv);
+		_types_and_constants.write(module.spirv);
+		_variables.write(module.spirv);
 
 		// All function definitions
-		for (const auto &function : _functions2)
+		for (size_t i = 0; i < _functions2.size(); ++i)
 		{
-			if (function.definition.instructions.empty())
+			function_blocks &function = _functions2[i];
+			if (function.definition.empty() || !function_used[i])
 				continue;
 
-			for (const auto &node : function.declaration.instructions)
-				node.write(module.spirv);
+			function.declaration.write(module.spirv);
 
 			// Grab first label and move it in front of variable declarations
-			function.definition.instructions.front().write(module.spirv);
-			assert(function.definition.instructions.front().op == spv::OpLabel);
+			function.definition.flush();
+			assert(function.definition.words.size() >= 2 && function.definition.words[0] == ((2u << spv::WordCountShift) | spv::OpLabel));
+			module.spirv.insert(module.spirv.end(), function.definition.words.begin(), function.definition.words.begin() + 2);
+
+			function.variables.write(module.spirv);
+			module.spirv.insert(module.spirv.end(), function.definition.words.begin() + 2, function.definition.words.end());
+		}
+	}
+
+	/// <summary>
+	/// Remove all variables with one of the specified IDs from a block, as well as all names and decorations that target them.
+	/// </summary>
+	static void remove_instructions(spirv_basic_block &block, const std::unordered_set<spv::Id> &ids)
+	{
+		block.flush();
+
+		std::vector<uint32_t> &words = block.words;
+		size_t write_offset = 0;
+		size_t line_offset = 0;
+		bool follows_line = false;
+
+		for (size_t read_offset = 0, num_words = 0; read_offset < words.size(); read_offset += num_words)
+		{
+			num_words = words[read_offset] >> spv::WordCountShift;
+			const spv::Op op = static_cast<spv::Op>(words[read_offset] & spv::OpCodeMask);
+
+			spv::Id target = 0;
+			if (op == spv::OpName || op == spv::OpDecorate || op == spv::OpDecorateStringGOOGLE)
+				target = words[read_offset + 1];
+			else if (op == spv::OpVariable)
+				target = words[read_offset + 2];
+
+			if (target != 0 && ids.find(target) != ids.end())
+			{
+				// Remove the debug line information of a variable too
+				if (op == spv::OpVariable && follows_line)
+					write_offset = line_offset;
+				follows_line = false;
+				continue;
+			}
+
+			follows_line = op == spv::OpLine;
+			line_offset = write_offset;
 
-			for (const auto &node : function.variables.instructions)
-				node.write(module.spirv);
-			for (auto it = function.definition.instructions.begin() + 1; it != function.definition.instructions.end(); ++it)
-				it->write(module.spirv);
+			std::copy(words.begin() + read_offset, words.begin() + read_offset + num_words, words.begin() + write_offset);
+			write_offset += num_words;
 		}
+
+		words.resize(write_offset);
 	}
 
 	spv::Id convert_type(const type &info, bool is_ptr = false, spv::StorageClass storage = spv::StorageClassFunction)
 	{
-		if (auto it = std::find_if(_type_lookup.begin(), _type_lookup.end(),
-			[&](auto &x) { return x.type == info && x.is_ptr == is_ptr && x.storage == storage; }); it != _type_lookup.end())
-			return it->id;
+		// Minimum precision is expressed with a decoration on the values instead (see 'add_relaxed_precision'), so it uses the same types as full precision
+		if (info.base == type::t_min16float)
+			return convert_type(full_precision(info), is_ptr, storage);
+
+		const type_lookup lookup = { info, storage, is_ptr };
+
+		if (const auto it = _type_lookup.find(lookup); it != _type_lookup.end())
+			return it->second;
 
 		spv::Id type;
 
@@ -440,19 +673,26 @@ private:
 			}
 		}
 
-		_type_lookup.push_back({ info, storage, is_ptr, type });;
+		_type_lookup.emplace(lookup, type);
 
 		return type;
 	}
 	spv::Id convert_type(const function_blocks &info)
 	{
-		if (auto it = std::find_if(_function_type_lookup.begin(), _function_type_lookup.end(), [&info](auto &x) { return x.first == info; }); it != _function_type_lookup.end())
+		// Only store the function signature in the lookup table, the instruction blocks are not needed for comparison
+		// Signatures that only differ in precision share the same function type, like the types of their parameters do
+		function_blocks signature;
+		signature.return_type = full_precision(info.return_type);
+		for (const type &param_type : info.param_types)
+			signature.param_types.push_back(full_precision(param_type));
+
+		if (const auto it = _function_type_lookup.find(signature); it != _function_type_lookup.end())
 			return it->second;
 
-		spv::Id return_type = convert_type(info.return_type);
+		spv::Id return_type = convert_type(signature.return_type);
 		assert(return_type != 0);
 		std::vector<spv::Id> param_type_ids;
-		for (auto param : info.param_types)
+		for (auto param : signature.param_types)
 			param_type_ids.push_back(convert_type(param, true));
 
 		spirv_instruction &node = add_instruction(spv::OpTypeFunction, 0, _types_and_constants);
@@ -460,11 +700,18 @@ private:
 		for (auto param_type : param_type_ids)
 			node.add(param_type);
 
-		_function_type_lookup.push_back({ info, node.result });;
+		_function_type_lookup.emplace(std::move(signature), node.result);
 
 		return node.result;
 	}
 
+	static type full_precision(type info)
+	{
+		if (info.base == type::t_min16float)
+			info.base = type::t_float;
+		return info;
+	}
+
 	inline void add_name(id id, const char *name)
 	{
 		if (!_debug_info)
@@ -500,6 +747,17 @@ private:
 			.add(decoration)
 			.add(values.begin(), values.end());
 	}
+	inline void add_relaxed_precision(id id, const type &type)
+	{
+		if (type.base != type::t_min16float)
+			return;
+
+		// https://www.khronos.org/registry/spir-v/specs/unified1/SPIRV.html#_a_id_relaxedprecisionsection_a_relaxed_precision
+		add_decoration(id, spv::DecorationRelaxedPrecision);
+
+		if (is_in_function())
+			_current_function->relaxed_precision_values.push_back(id);
+	}
 	inline void add_member_name(id id, uint32_t member_index, const char *name)
 	{
 		if (!_debug_info)
@@ -569,8 +827,13 @@ private:
 			add_name(info.definition, info.unique_name.c_str());
 
 		for (uint32_t index = 0; index < info.member_list.size(); ++index)
+		{
 			add_member_name(info.definition, index, info.member_list[index].name.c_str());
 
+			if (info.member_list[index].type.base == type::t_min16float)
+				add_member_decoration(info.definition, index, spv::DecorationRelaxedPrecision);
+		}
+
 		_structs.push_back(info);
 
 		return info.definition;
@@ -593,6 +856,8 @@ private:
 		add_decoration(info.id, spv::DecorationBinding, { info.binding });
 		add_decoration(info.id, spv::DecorationDescriptorSet, { 1 });
 
+		_removable_variables.insert(info.id);
+
 		_module.samplers.push_back(info);
 
 		return info.id;
@@ -663,6 +928,9 @@ private:
 
 		define_variable(res, loc, type, name.c_str(), global ? spv::StorageClassPrivate : spv::StorageClassFunction, initializer_value);
 
+		if (global)
+			_removable_variables.insert(res);
+
 		return res;
 	}
 	void define_variable(id id, const location &loc, const type &type, const char *name, spv::StorageClass storage, spv::Id initializer_value = 0)
@@ -682,6 +950,8 @@ private:
 		if (name != nullptr && *name != '\0')
 			add_name(id, name);
 
+		add_relaxed_precision(id, type);
+
 		_storage_lookup[id] = storage;
 	}
 	id   define_function(const location &loc, function_info &info) override
@@ -706,6 +976,8 @@ private:
 		if (!info.name.empty())
 			add_name(info.definition, info.name.c_str());
 
+		add_relaxed_precision(info.definition, info.return_type);
+
 		for (auto &param : info.parameter_list)
 		{
 			add_location(param.location, function.declaration);
@@ -714,6 +986,8 @@ private:
 				.result;
 
 			add_name(param.definition, param.name.c_str());
+
+			add_relaxed_precision(param.definition, param.type);
 		}
 
 		_functions.push_back(std::make_unique<function_info>(info));
@@ -979,6 +1253,9 @@ private:
 		leave_block_and_return(0);
 		leave_function();
 
+		// The generated entry point function is not referenced by any code, so explicitly keep it
+		add_reference(entry_point.definition);
+
 		assert(!func.unique_name.empty());
 		add_instruction_without_result(spv::OpEntryPoint, _entries)
 			.add(is_ps ? spv::ExecutionModelFragment : spv::ExecutionModelVertex)
@@ -1085,6 +1362,8 @@ private:
 			switch (op.op)
 			{
 			case expression::operation::op_cast:
+				if (op.from.is_floating_point() && op.to.is_floating_point())
+					break; // Minimum and full precision floating-point values have the same type, so there is nothing to convert
 				if (op.from.is_boolean())
 				{
 					const spv::Id true_constant = emit_constant(op.to, 1);
@@ -1115,6 +1394,7 @@ private:
 					case type::t_uint:
 						spv_op = op.from.is_floating_point() ? spv::OpConvertFToU : spv::OpBitcast;
 						break;
+					case type::t_min16float:
 					case type::t_float:
 						assert(op.from.is_integral());
 						spv_op = op.from.is_signed() ? spv::OpConvertSToF : spv::OpConvertUToF;
@@ -1235,6 +1515,9 @@ private:
 			}
 		}
 
+		if (result != exp.base)
+			add_relaxed_precision(result, exp.type);
+
 		return result;
 	}
 	void emit_store(const expression &exp, id value) override
@@ -1369,16 +1652,13 @@ private:
 	}
 	id   emit_constant(const type &type, const constant &data, bool spec_constant)
 	{
+		// Constants are the same for minimum and full precision (see 'convert_type')
+		if (type.base == type::t_min16float)
+			return emit_constant(full_precision(type), data, spec_constant);
+
 		if (!spec_constant)
-			if (auto it = std::find_if(_constant_lookup.begin(), _constant_lookup.end(), [&type, &data](auto &x) {
-				if (!(std::get<0>(x) == type && std::memcmp(&std::get<1>(x).as_uint[0], &data.as_uint[0], sizeof(uint32_t) * 16) == 0 && std::get<1>(x).array_data.size() == data.array_data.size()))
-					return false;
-				for (size_t i = 0; i < data.array_data.size(); ++i)
-					if (std::memcmp(&std::get<1>(x).array_data[i].as_uint[0], &data.array_data[i].as_uint[0], sizeof(uint32_t) * 16) != 0)
-						return false;
-				return true;
-			}); it != _constant_lookup.end())
-				return std::get<2>(*it);
+			if (const auto it = _constant_lookup.find({ type, data }); it != _constant_lookup.end())
+				return it->second;
 
 		spv::Id result = 0;
 
@@ -1483,7 +1763,7 @@ private:
 		}
 
 		if (!spec_constant)
-			_constant_lookup.push_back({ type, data, result });
+			_constant_lookup.emplace(constant_lookup { type, data }, result);
 
 		return result;
 	}
@@ -1513,6 +1793,8 @@ private:
 			.add(val) // Operand
 			.result; // Result ID
 
+		add_relaxed_precision(result, type);
+
 		return result;
 	}
 	id   emit_binary_op(const location &loc, tokenid op, const type &res_type, const type &type, id lhs, id rhs) override
@@ -1607,6 +1889,8 @@ private:
 		if (res_type.has(type::q_precise))
 			add_decoration(result, spv::DecorationNoContraction);
 
+		add_relaxed_precision(result, res_type);
+
 		return result;
 	}
 	id   emit_ternary_op(const location &loc, tokenid op, const type &type, id condition, id true_value, id false_value) override
@@ -1621,6 +1905,8 @@ private:
 			.add(false_value) // Object 2
 			.result; // Result ID
 
+		add_relaxed_precision(result, type);
+
 		return result;
 	}
 	id   emit_call(const location &loc, id function, const type &res_type, const std::vector<expression> &args) override
@@ -1638,6 +1924,8 @@ private:
 		for (size_t i = 0; i < args.size(); ++i)
 			call.add(args[i].base); // Arguments
 
+		add_relaxed_precision(call.result, res_type);
+
 		return call.result;
 	}
 	id   emit_call_intrinsic(const location &loc, id intrinsic, const type &res_type, const std::vector<expression> &args) override
@@ -1655,13 +1943,21 @@ private:
 #include "effect_symbol_table_intrinsics.inl"
 		};
 
-		switch (intrinsic)
-		{
+		const spv::Id result = [&]() -> spv::Id {
+			switch (intrinsic)
+			{
 #define IMPLEMENT_INTRINSIC_SPIRV(name, i, code) case name##i: code
 #include "effect_symbol_table_intrinsics.inl"
-		default:
-			return 0;
-		}
+			default:
+				return 0;
+			}
+		}();
+
+		// Some intrinsics simply pass on one of their arguments, which must not be decorated again
+		if (std::none_of(args.begin(), args.end(), [result](const expression &arg) { return arg.base == result; }))
+			add_relaxed_precision(result, res_type);
+
+		return result;
 	}
 	id   emit_construct(const location &loc, const type &type, const std::vector<expression> &args) override
 	{
@@ -1704,23 +2000,25 @@ private:
 				ids.push_back(arg.base);
 		}
 
-		return add_instruction(spv::OpCompositeConstruct, convert_type(type))
+		const spv::Id result = add_instruction(spv::OpCompositeConstruct, convert_type(type))
 			.add(ids.begin(), ids.end())
 			.result;
+
+		add_relaxed_precision(result, type);
+
+		return result;
 	}
 
 	void emit_if(const location &loc, id, id condition_block, id true_statement_block, id false_statement_block, unsigned int selection_control) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
+		spirv_instruction merge_label = _current_block_data->pop_instruction();
 		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
 
-		// Add previous block containing the condition value first
-		_current_block_data->append(_block_data[condition_block]);
-
-		spirv_instruction branch_inst = _current_block_data->instructions.back();
+		spirv_instruction branch_inst = _block_data[condition_block].pop_instruction();
 		assert(branch_inst.op == spv::OpBranchConditional);
-		_current_block_data->instructions.pop_back();
+
+		// Add previous block containing the condition value first
+		append_block(condition_block);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
@@ -1729,27 +2027,26 @@ private:
 			.add(selection_control); // 'SelectionControl' happens to match the flags produced by the parser
 
 		// Append all blocks belonging to the branch
-		_current_block_data->instructions.push_back(branch_inst);
-		_current_block_data->append(_block_data[true_statement_block]);
-		_current_block_data->append(_block_data[false_statement_block]);
+		_current_block_data->add_instruction(std::move(branch_inst));
+		append_block(true_statement_block);
+		append_block(false_statement_block);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->add_instruction(std::move(merge_label));
 	}
 	id   emit_phi(const location &loc, id, id condition_block, id true_value, id true_statement_block, id false_value, id false_statement_block, const type &type) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
+		spirv_instruction merge_label = _current_block_data->pop_instruction();
 		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
 
 		// Add previous block containing the condition value first
-		_current_block_data->append(_block_data[condition_block]);
+		append_block(condition_block);
 
 		if (true_statement_block != condition_block)
-			_current_block_data->append(_block_data[true_statement_block]);
+			append_block(true_statement_block);
 		if (false_statement_block != condition_block)
-			_current_block_data->append(_block_data[false_statement_block]);
+			append_block(false_statement_block);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->add_instruction(std::move(merge_label));
 
 		add_location(loc, *_current_block_data);
 
@@ -1761,21 +2058,23 @@ private:
 			.add(false_statement_block) // Parent 1
 			.result;
 
+		add_relaxed_precision(result, type);
+
 		return result;
 	}
 	void emit_loop(const location &loc, id, id prev_block, id header_block, id condition_block, id loop_block, id continue_block, unsigned int loop_control) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
+		spirv_instruction merge_label = _current_block_data->pop_instruction();
 		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
 
 		// Add previous block first
-		_current_block_data->append(_block_data[prev_block]);
+		append_block(prev_block);
 
 		// Fill header block
-		assert(_block_data[header_block].instructions.size() == 2);
-		_current_block_data->instructions.push_back(_block_data[header_block].instructions[0]);
-		assert(_current_block_data->instructions.back().op == spv::OpLabel);
+		spirv_instruction branch_inst = _block_data[header_block].pop_instruction();
+		assert(branch_inst.op == spv::OpBranch);
+		assert(_block_data[header_block].words.size() == 2 && _block_data[header_block].words[0] == ((2u << spv::WordCountShift) | spv::OpLabel));
+		append_block(header_block);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
@@ -1784,31 +2083,28 @@ private:
 			.add(continue_block)
 			.add(loop_control); // 'LoopControl' happens to match the flags produced by the parser
 
-		_current_block_data->instructions.push_back(_block_data[header_block].instructions[1]);
-		assert(_current_block_data->instructions.back().op == spv::OpBranch);
+		_current_block_data->add_instruction(std::move(branch_inst));
 
 		// Add condition block if it exists
 		if (condition_block != 0)
-			_current_block_data->append(_block_data[condition_block]);
+			append_block(condition_block);
 
 		// Append loop body block before continue block
-		_current_block_data->append(_block_data[loop_block]);
-		_current_block_data->append(_block_data[continue_block]);
+		append_block(loop_block);
+		append_block(continue_block);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->add_instruction(std::move(merge_label));
 	}
 	void emit_switch(const location &loc, id, id selector_block, id default_label, const std::vector<id> &case_literal_and_labels, unsigned int selection_control) override
 	{
-		spirv_instruction merge_label = _current_block_data->instructions.back();
+		spirv_instruction merge_label = _current_block_data->pop_instruction();
 		assert(merge_label.op == spv::OpLabel);
-		_current_block_data->instructions.pop_back();
 
-		// Add previous block containing the selector value first
-		_current_block_data->append(_block_data[selector_block]);
-
-		spirv_instruction switch_inst = _current_block_data->instructions.back();
+		spirv_instruction switch_inst = _block_data[selector_block].pop_instruction();
 		assert(switch_inst.op == spv::OpSwitch);
-		_current_block_data->instructions.pop_back();
+
+		// Add previous block containing the selector value first
+		append_block(selector_block);
 
 		// Add structured control flow instruction
 		add_location(loc, *_current_block_data);
@@ -1821,13 +2117,13 @@ private:
 		switch_inst.add(case_literal_and_labels.begin(), case_literal_and_labels.end());
 
 		// Append all blocks belonging to the switch
-		_current_block_data->instructions.push_back(switch_inst);
+		_current_block_data->add_instruction(std::move(switch_inst));
 		for (size_t i = 0; i < case_literal_and_labels.size(); i += 2)
-			_current_block_data->append(_block_data[case_literal_and_labels[i + 1]]);
+			append_block(case_literal_and_labels[i + 1]);
 		if (default_label != merge_label.result)
-			_current_block_data->append(_block_data[default_label]);
+			append_block(default_label);
 
-		_current_block_data->instructions.push_back(merge_label);
+		_current_block_data->add_instruction(std::move(merge_label));
 	}
 
 	bool is_in_function() const override { return _current_function != nullptr; }
@@ -1930,7 +2226,8 @@ private:
 	{
 		assert(is_in_function()); // Can only leave if there was a function to begin with
 
-		_current_function->definition = _block_data[_last_block];
+		_current_function->definition = std::move(_block_data[_last_block]);
+		_block_data.erase(_last_block);
 
 		// Append function end instruction
 		add_instruction_without_result(spv::OpFunctionEnd, _current_function->definition);
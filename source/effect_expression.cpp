@@ -7,6 +7,42 @@
 #include "effect_lexer.hpp"
 #include "effect_codegen.hpp"
 #include <assert.h>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <limits>
+#include <algorithm>
+
+// Source file names are shared between all preprocessor and parser instances (and thus across threads), since locations referencing them are passed between those and the code generation back-ends
+static std::mutex s_source_names_mutex;
+static std::deque<std::string> s_source_names(1); // Identifier zero is reserved for locations without a file name
+static std::unordered_map<std::string, uint32_t> s_source_lookup;
+
+uint32_t reshadefx::location::intern_source(const std::string &name)
+{
+	if (name.empty())
+		return 0;
+
+	const std::lock_guard<std::mutex> lock(s_source_names_mutex);
+
+	if (const auto it = s_source_lookup.find(name); it != s_source_lookup.end())
+		return it->second;
+
+	const auto source = static_cast<uint32_t>(s_source_names.size());
+	s_source_names.push_back(name);
+	s_source_lookup.emplace(name, source);
+
+	return source;
+}
+const std::string &reshadefx::location::source_name(uint32_t source)
+{
+	const std::lock_guard<std::mutex> lock(s_source_names_mutex);
+
+	assert(source < s_source_names.size());
+
+	// Elements of a deque are never moved when appending, so it is safe to return a reference here
+	return s_source_names[source];
+}
 
 reshadefx::type reshadefx::type::merge(const type &lhs, const type &rhs)
 {
@@ -462,3 +498,145 @@ bool reshadefx::expression::evaluate_constant_expression(reshadefx::tokenid op,
 
 	return true;
 }
+bool reshadefx::expression::evaluate_constant_intrinsic(const reshadefx::location &loc, uint32_t intrinsic, const reshadefx::type &res_type, const std::vector<expression> &args)
+{
+	enum
+	{
+#define IMPLEMENT_INTRINSIC_SPIRV(name, i, code) name##i,
+#include "effect_symbol_table_intrinsics.inl"
+	};
+
+	for (const expression &arg : args)
+		if (!arg.is_constant || arg.type.is_array())
+			return false;
+
+	// Scalar arguments apply to all components of the result
+	const auto f = [&args](size_t index, unsigned int c) { return args[index].constant.as_float[args[index].type.is_scalar() ? 0 : c]; };
+	const auto i = [&args](size_t index, unsigned int c) { return args[index].constant.as_int[args[index].type.is_scalar() ? 0 : c]; };
+	const auto u = [&args](size_t index, unsigned int c) { return args[index].constant.as_uint[args[index].type.is_scalar() ? 0 : c]; };
+
+	reshadefx::constant data = {};
+
+	// Intrinsics that combine the components of their arguments
+	switch (intrinsic)
+	{
+	case all0:
+	case all1:
+		data.as_uint[0] = 1;
+		for (unsigned int c = 0; c < args[0].type.components(); ++c)
+			data.as_uint[0] &= u(0, c) != 0;
+		break;
+	case any0:
+	case any1:
+		for (unsigned int c = 0; c < args[0].type.components(); ++c)
+			data.as_uint[0] |= u(0, c) != 0;
+		break;
+	case cross0:
+		data.as_float[0] = f(0, 1) * f(1, 2) - f(0, 2) * f(1, 1);
+		data.as_float[1] = f(0, 2) * f(1, 0) - f(0, 0) * f(1, 2);
+		data.as_float[2] = f(0, 0) * f(1, 1) - f(0, 1) * f(1, 0);
+		break;
+	case distance0:
+		for (unsigned int c = 0; c < args[0].type.components(); ++c)
+			data.as_float[0] += (f(0, c) - f(1, c)) * (f(0, c) - f(1, c));
+		data.as_float[0] = std::sqrt(data.as_float[0]);
+		break;
+	case dot0:
+		for (unsigned int c = 0; c < args[0].type.components(); ++c)
+			data.as_float[0] += f(0, c) * f(1, c);
+		break;
+	case length0:
+		for (unsigned int c = 0; c < args[0].type.components(); ++c)
+			data.as_float[0] += f(0, c) * f(0, c);
+		data.as_float[0] = std::sqrt(data.as_float[0]);
+		break;
+	case normalize0:
+	{
+		float length = 0.0f;
+		for (unsigned int c = 0; c < args[0].type.components(); ++c)
+			length += f(0, c) * f(0, c);
+		length = std::sqrt(length);
+		for (unsigned int c = 0; c < res_type.components(); ++c)
+			data.as_float[c] = f(0, c) / length;
+		break;
+	}
+	default:
+		// Everything else works on each component separately
+		for (unsigned int c = 0; c < res_type.components(); ++c)
+		{
+			float &r = data.as_float[c];
+
+			switch (intrinsic)
+			{
+			case abs0: data.as_int[c] = i(0, c) == std::numeric_limits<int32_t>::min() ? i(0, c) : std::abs(i(0, c)); break;
+			case abs1: r = std::abs(f(0, c)); break;
+			case acos0: r = std::acos(f(0, c)); break;
+			case asfloat0: case asfloat1: case asint0: case asuint0: data.as_uint[c] = u(0, c); break;
+			case asin0: r = std::asin(f(0, c)); break;
+			case atan0: r = std::atan(f(0, c)); break;
+			case atan20: r = std::atan2(f(0, c), f(1, c)); break;
+			case ceil0: r = std::ceil(f(0, c)); break;
+			case clamp0: data.as_int[c] = std::min(std::max(i(0, c), i(1, c)), i(2, c)); break;
+			case clamp1: data.as_uint[c] = std::min(std::max(u(0, c), u(1, c)), u(2, c)); break;
+			case clamp2: r = std::min(std::max(f(0, c), f(1, c)), f(2, c)); break;
+			case cos0: r = std::cos(f(0, c)); break;
+			case cosh0: r = std::cosh(f(0, c)); break;
+			case degrees0: r = f(0, c) * 57.29577951f; break;
+			case exp0: r = std::exp(f(0, c)); break;
+			case exp20: r = std::exp2(f(0, c)); break;
+			case floor0: r = std::floor(f(0, c)); break;
+			case frac0: r = f(0, c) - std::floor(f(0, c)); break;
+			case ldexp0: r = std::ldexp(f(0, c), i(1, c)); break;
+			case lerp0: r = f(0, c) + (f(1, c) - f(0, c)) * f(2, c); break;
+			case log0: r = std::log(f(0, c)); break;
+			case log100: r = std::log10(f(0, c)); break;
+			case log20: r = std::log2(f(0, c)); break;
+			case mad0: r = f(0, c) * f(1, c) + f(2, c); break;
+			case max0: data.as_int[c] = std::max(i(0, c), i(1, c)); break;
+			case max1: r = std::max(f(0, c), f(1, c)); break;
+			case min0: data.as_int[c] = std::min(i(0, c), i(1, c)); break;
+			case min1: r = std::min(f(0, c), f(1, c)); break;
+			case pow0:
+				// The result of pow is undefined for negative bases and zero
+				if (f(0, c) <= 0.0f)
+					return false;
+				r = std::pow(f(0, c), f(1, c));
+				break;
+			case radians0: r = f(0, c) * 0.01745329252f; break;
+			case rcp0: r = 1.0f / f(0, c); break;
+			case round0: r = std::nearbyint(f(0, c)); break; // Halfway cases are rounded to the nearest even integer
+			case rsqrt0: r = 1.0f / std::sqrt(f(0, c)); break;
+			case saturate0: r = std::min(std::max(f(0, c), 0.0f), 1.0f); break;
+			case sign0: data.as_int[c] = (i(0, c) > 0) - (i(0, c) < 0); break;
+			case sign1: r = static_cast<float>((f(0, c) > 0.0f) - (f(0, c) < 0.0f)); break;
+			case sin0: r = std::sin(f(0, c)); break;
+			case sinh0: r = std::sinh(f(0, c)); break;
+			case smoothstep0:
+				// The result of smoothstep is undefined if both edges are the same
+				if (f(0, c) == f(1, c))
+					return false;
+				r = std::min(std::max((f(2, c) - f(0, c)) / (f(1, c) - f(0, c)), 0.0f), 1.0f);
+				r = r * r * (3.0f - 2.0f * r);
+				break;
+			case sqrt0: r = std::sqrt(f(0, c)); break;
+			case step0: r = f(1, c) >= f(0, c) ? 1.0f : 0.0f; break;
+			case tan0: r = std::tan(f(0, c)); break;
+			case tanh0: r = std::tanh(f(0, c)); break;
+			case trunc0: r = std::trunc(f(0, c)); break;
+			default:
+				return false; // Not a pure math function
+			}
+		}
+		break;
+	}
+
+	// Leave infinities and NaNs (e.g. from division by zero or out of range arguments) to the target, since they cannot be written as literals and their exact behavior differs between platforms
+	if (res_type.is_floating_point())
+		for (unsigned int c = 0; c < res_type.components(); ++c)
+			if (!std::isfinite(data.as_float[c]))
+				return false;
+
+	reset_to_rvalue_constant(loc, std::move(data), res_type);
+
+	return true;
+}
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <functional> // std::hash
 
 namespace reshadefx
 {
@@ -16,11 +17,24 @@ namespace reshadefx
 	/// </summary>
 	struct location
 	{
-		location() : line(1), column(1) { }
-		explicit location(unsigned int line, unsigned int column = 1) : line(line), column(column) { }
-		explicit location(std::string source, unsigned int line, unsigned int column = 1) : source(std::move(source)), line(line), column(column) { }
+		location() : source(0), line(1), column(1) { }
+		explicit location(unsigned int line, unsigned int column = 1) : source(0), line(line), column(column) { }
+		explicit location(uint32_t source, unsigned int line, unsigned int column = 1) : source(source), line(line), column(column) { }
 
-		std::string source;
+		/// <summary>
+		/// Get the compact identifier for a source file name, adding it to the table of known file names if necessary.
+		/// </summary>
+		/// <param name="name">The file name to look up.</param>
+		/// <returns>The identifier to store in a location, which is zero for an empty file name.</returns>
+		static uint32_t intern_source(const std::string &name);
+		/// <summary>
+		/// Get the file name that belongs to an identifier returned by <see cref="intern_source"/>.
+		/// </summary>
+		/// <param name="source">The file name identifier to look up.</param>
+		/// <returns>A reference to the file name, which stays valid for the lifetime of the process.</returns>
+		static const std::string &source_name(uint32_t source);
+
+		uint32_t source; // Identifier of the source file name (see 'source_name')
 		unsigned int line, column;
 	};
 
@@ -35,6 +49,7 @@ namespace reshadefx
 			t_bool,
 			t_int,
 			t_uint,
+			t_min16float,
 			t_float,
 			t_string,
 			t_struct,
@@ -74,12 +89,12 @@ namespace reshadefx
 		bool is_scalar() const { return !is_array() && !is_matrix() && !is_vector() && is_numeric(); }
 		bool is_vector() const { return rows > 1 && cols == 1; }
 		bool is_matrix() const { return rows >= 1 && cols > 1; }
-		bool is_signed() const { return base == t_int || base == t_float; }
+		bool is_signed() const { return base == t_int || base == t_min16float || base == t_float; }
 		bool is_numeric() const { return is_integral() || is_floating_point(); }
 		bool is_void() const { return base == t_void; }
 		bool is_boolean() const { return base == t_bool; }
 		bool is_integral() const { return base == t_bool || base == t_int || base == t_uint; }
-		bool is_floating_point() const { return base == t_float; }
+		bool is_floating_point() const { return base == t_min16float || base == t_float; }
 		bool is_struct() const { return base == t_struct; }
 		bool is_texture() const { return base == t_texture; }
 		bool is_sampler() const { return base == t_sampler; }
@@ -218,6 +233,15 @@ namespace reshadefx
 		/// <param name="op">The binary operator to apply.</param>
 		/// <param name="rhs">The constant to use as right-hand side of the binary operation.</param>
 		bool evaluate_constant_expression(enum class tokenid op, const reshadefx::constant &rhs);
+		/// <summary>
+		/// Evaluate a call to a math intrinsic function with constant arguments and turn this expression into a constant with the result.
+		/// </summary>
+		/// <param name="loc">The code location of the call.</param>
+		/// <param name="intrinsic">The ID of the intrinsic function to evaluate.</param>
+		/// <param name="res_type">The result type of the intrinsic function.</param>
+		/// <param name="args">The arguments to the call, already cast to the parameter types.</param>
+		/// <returns><c>true</c> if the call was evaluated, or <c>false</c> if the intrinsic has no compile-time implementation, the arguments are not all constant or the result would not be finite. This expression is left unchanged then.</returns>
+		bool evaluate_constant_intrinsic(const reshadefx::location &loc, uint32_t intrinsic, const reshadefx::type &res_type, const std::vector<expression> &args);
 	};
 
 
@@ -368,6 +392,8 @@ namespace reshadefx
 		std::string name;
 		bool is_pixel_shader;
 		std::string assembly;
+		// Source code containing only what this entry point uses (only filled in by the GLSL back-end)
+		std::string code;
 	};
 
 	/// <summary>
@@ -386,3 +412,21 @@ namespace reshadefx
 		uint32_t num_texture_bindings = 0;
 	};
 }
+
+namespace std
+{
+	template <>
+	struct hash<reshadefx::type>
+	{
+		size_t operator()(const reshadefx::type &type) const
+		{
+			// Only hash the members that are compared in 'operator==' (qualifiers are ignored there)
+			size_t result = type.base;
+			result = result * 31 + type.rows;
+			result = result * 31 + type.cols;
+			result = result * 31 + static_cast<unsigned int>(type.array_length);
+			result = result * 31 + type.definition;
+			return result;
+		}
+	};
+}
@@ -4,8 +4,21 @@
  */
 
 #include "effect_lexer.hpp"
+#include <cstring>
+#include <string_view>
 #include <unordered_map>
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+	#include <emmintrin.h>
+	#define RESHADEFX_LEXER_SSE2 1
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define RESHADEFX_LEXER_NEON 1
+#endif
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
 using namespace reshadefx;
 
 enum token_type
@@ -32,6 +45,129 @@ static const unsigned type_lookup[256] = {
 	IDENT, IDENT, IDENT,   '{',   '|',   '}',   '~',  0x00,  0x00,  0x00,
 };
 
+// Character classes that the scanning loops below search for
+// Each provides a scalar test and a vector version of it, which sets every byte lane for which the test succeeds to all ones
+struct not_space_char
+{
+	static bool test(char c) { return type_lookup[static_cast<unsigned char>(c)] != SPACE; }
+#if RESHADEFX_LEXER_SSE2
+	static __m128i test(__m128i c)
+	{
+		// Space is ' ' or any of '\t', '\v', '\f' and '\r' (so the range from 9 to 13 without '\n')
+		const __m128i range = _mm_sub_epi8(c, _mm_set1_epi8(9));
+		const __m128i space = _mm_or_si128(
+			_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+			_mm_andnot_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(_mm_min_epu8(range, _mm_set1_epi8(4)), range)));
+		return _mm_xor_si128(space, _mm_set1_epi8(-1));
+	}
+#elif RESHADEFX_LEXER_NEON
+	static uint8x16_t test(uint8x16_t c)
+	{
+		const uint8x16_t space = vorrq_u8(
+			vceqq_u8(c, vdupq_n_u8(' ')),
+			vbicq_u8(vcleq_u8(vsubq_u8(c, vdupq_n_u8(9)), vdupq_n_u8(4)), vceqq_u8(c, vdupq_n_u8('\n'))));
+		return vmvnq_u8(space);
+	}
+#endif
+};
+struct not_identifier_char
+{
+	static bool test(char c) { const unsigned type = type_lookup[static_cast<unsigned char>(c)]; return type != IDENT && type != DIGIT; }
+#if RESHADEFX_LEXER_SSE2
+	static __m128i test(__m128i c)
+	{
+		// Identifier characters are 'a' to 'z' and 'A' to 'Z' (which are the same range after setting the lower case bit), '0' to '9' and '_'
+		const __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+		const __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+		const __m128i ident = _mm_or_si128(
+			_mm_or_si128(
+				_mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(25)), alpha),
+				_mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit)),
+			_mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+		return _mm_xor_si128(ident, _mm_set1_epi8(-1));
+	}
+#elif RESHADEFX_LEXER_NEON
+	static uint8x16_t test(uint8x16_t c)
+	{
+		const uint8x16_t ident = vorrq_u8(
+			vorrq_u8(
+				vcleq_u8(vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a')), vdupq_n_u8(25)),
+				vcleq_u8(vsubq_u8(c, vdupq_n_u8('0')), vdupq_n_u8(9))),
+			vceqq_u8(c, vdupq_n_u8('_')));
+		return vmvnq_u8(ident);
+	}
+#endif
+};
+struct line_feed_char
+{
+	static bool test(char c) { return c == '\n'; }
+#if RESHADEFX_LEXER_SSE2
+	static __m128i test(__m128i c) { return _mm_cmpeq_epi8(c, _mm_set1_epi8('\n')); }
+#elif RESHADEFX_LEXER_NEON
+	static uint8x16_t test(uint8x16_t c) { return vceqq_u8(c, vdupq_n_u8('\n')); }
+#endif
+};
+struct line_feed_or_star_char
+{
+	static bool test(char c) { return c == '\n' || c == '*'; }
+#if RESHADEFX_LEXER_SSE2
+	static __m128i test(__m128i c) { return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(c, _mm_set1_epi8('*'))); }
+#elif RESHADEFX_LEXER_NEON
+	static uint8x16_t test(uint8x16_t c) { return vorrq_u8(vceqq_u8(c, vdupq_n_u8('\n')), vceqq_u8(c, vdupq_n_u8('*'))); }
+#endif
+};
+
+/// <summary>
+/// Find the first character in the range [<paramref name="cur"/>, <paramref name="end"/>) that belongs to the specified character class.
+/// Long runs are scanned 16 characters at a time with SSE2 or NEON where available, the remainder one character at a time.
+/// </summary>
+/// <returns>A pointer to the found character, or <paramref name="end"/> if there is none.</returns>
+template <typename char_class>
+static const char *find_first(const char *cur, const char *end)
+{
+	// Most runs are only a few characters long, so test the first character by itself before setting up the vector loop
+	if (cur >= end || char_class::test(*cur))
+		return cur;
+
+#if RESHADEFX_LEXER_SSE2
+	for (; end - cur >= 16; cur += 16)
+	{
+		const unsigned int mask = _mm_movemask_epi8(char_class::test(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur))));
+		if (mask != 0)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+#else
+			const unsigned int index = __builtin_ctz(mask);
+#endif
+			return cur + index;
+		}
+	}
+#elif RESHADEFX_LEXER_NEON
+	for (; end - cur >= 16; cur += 16)
+	{
+		// There is no equivalent to 'movemask' on ARM, so narrow each byte lane to four bits instead and look for the first set one in the resulting 64-bit value
+		const uint8x16_t lanes = char_class::test(vld1q_u8(reinterpret_cast<const uint8_t *>(cur)));
+		const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(lanes), 4)), 0);
+		if (mask != 0)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward64(&index, mask);
+#else
+			const unsigned int index = __builtin_ctzll(mask);
+#endif
+			return cur + (index >> 2);
+		}
+	}
+#endif
+
+	while (cur < end && !char_class::test(*cur))
+		cur++;
+	return cur;
+}
+
 // Lookup tables which translate a given string literal to a token and backwards
 static const std::unordered_map<tokenid, std::string> token_lookup = {
 	{ tokenid::end_of_file, "end of file" },
@@ -153,13 +289,91 @@ static const std::unordered_map<tokenid, std::string> token_lookup = {
 	{ tokenid::float2x2, "float2x2" },
 	{ tokenid::float3x3, "float3x3" },
 	{ tokenid::float4x4, "float4x4" },
+	{ tokenid::min16float, "min16float" },
+	{ tokenid::min16float2, "min16float2" },
+	{ tokenid::min16float3, "min16float3" },
+	{ tokenid::min16float4, "min16float4" },
+	{ tokenid::min16float2x2, "min16float2x2" },
+	{ tokenid::min16float3x3, "min16float3x3" },
+	{ tokenid::min16float4x4, "min16float4x4" },
 	{ tokenid::vector, "vector" },
 	{ tokenid::matrix, "matrix" },
 	{ tokenid::string_, "string" },
 	{ tokenid::texture, "texture" },
 	{ tokenid::sampler, "sampler" },
 };
-static const std::unordered_map<std::string, tokenid> keyword_lookup = {
+
+/// <summary>
+/// A keyword or preprocessor directive name and the token it translates to.
+/// </summary>
+struct keyword
+{
+	std::string_view name;
+	tokenid id = tokenid::unknown;
+};
+
+/// <summary>
+/// A hash table which translates a given identifier to a keyword token, constructed at compile-time.
+/// Lookups work directly on the input characters, without having to allocate a string or use a generic hash function.
+/// </summary>
+template <size_t SIZE>
+class keyword_table
+{
+	static_assert((SIZE & (SIZE - 1)) == 0, "table size has to be a power of two");
+
+public:
+	template <size_t N>
+	constexpr keyword_table(const keyword (&keywords)[N])
+	{
+		// Keep the table sparse, so that most lookups of identifiers that are not keywords hit an empty slot immediately
+		static_assert(N * 3 <= SIZE, "table size is too small for the number of keywords");
+
+		for (const keyword &k : keywords)
+		{
+			// Use linear probing to resolve collisions
+			size_t index = hash(k.name.data(), k.name.size());
+			while (!_slots[index].name.empty())
+				index = (index + 1) & (SIZE - 1);
+
+			_slots[index] = k;
+		}
+	}
+
+	/// <summary>
+	/// Find the keyword matching the specified identifier.
+	/// </summary>
+	/// <param name="name">The characters of the identifier.</param>
+	/// <param name="length">The number of characters in the identifier.</param>
+	/// <param name="id">Set to the keyword token if one was found.</param>
+	/// <returns><c>true</c> if the identifier is a keyword, <c>false</c> otherwise.</returns>
+	bool find(const char *name, size_t length, tokenid &id) const
+	{
+		for (size_t index = hash(name, length); !_slots[index].name.empty(); index = (index + 1) & (SIZE - 1))
+		{
+			if (_slots[index].name.size() == length && std::memcmp(_slots[index].name.data(), name, length) == 0)
+			{
+				id = _slots[index].id;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	static constexpr size_t hash(const char *name, size_t length)
+	{
+		// FNV-1a hash of the identifier characters
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < length; ++i)
+			hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+		return hash & (SIZE - 1);
+	}
+
+	keyword _slots[SIZE];
+};
+
+static constexpr keyword keyword_list[] = {
 	{ "asm", tokenid::reserved },
 	{ "asm_fragment", tokenid::reserved },
 	{ "auto", tokenid::reserved },
@@ -215,13 +429,13 @@ static const std::unordered_map<std::string, tokenid> keyword_lookup = {
 	{ "globallycoherent", tokenid::reserved },
 	{ "goto", tokenid::reserved },
 	{ "groupshared", tokenid::reserved },
-	{ "half", tokenid::reserved },
-	{ "half2", tokenid::reserved },
-	{ "half2x2", tokenid::reserved },
-	{ "half3", tokenid::reserved },
-	{ "half3x3", tokenid::reserved },
-	{ "half4", tokenid::reserved },
-	{ "half4x4", tokenid::reserved },
+	{ "half", tokenid::min16float },
+	{ "half2", tokenid::min16float2 },
+	{ "half2x2", tokenid::min16float2x2 },
+	{ "half3", tokenid::min16float3 },
+	{ "half3x3", tokenid::min16float3x3 },
+	{ "half4", tokenid::min16float4 },
+	{ "half4x4", tokenid::min16float4x4 },
 	{ "if", tokenid::if_ },
 	{ "in", tokenid::in },
 	{ "inline", tokenid::reserved },
@@ -237,6 +451,13 @@ static const std::unordered_map<std::string, tokenid> keyword_lookup = {
 	{ "linear", tokenid::linear },
 	{ "long", tokenid::reserved },
 	{ "matrix", tokenid::matrix },
+	{ "min16float", tokenid::min16float },
+	{ "min16float2", tokenid::min16float2 },
+	{ "min16float2x2", tokenid::min16float2x2 },
+	{ "min16float3", tokenid::min16float3 },
+	{ "min16float3x3", tokenid::min16float3x3 },
+	{ "min16float4", tokenid::min16float4 },
+	{ "min16float4x4", tokenid::min16float4x4 },
 	{ "mutable", tokenid::reserved },
 	{ "namespace", tokenid::namespace_ },
 	{ "new", tokenid::reserved },
@@ -322,7 +543,7 @@ static const std::unordered_map<std::string, tokenid> keyword_lookup = {
 	{ "volatile", tokenid::volatile_ },
 	{ "while", tokenid::while_ }
 };
-static const std::unordered_map<std::string, tokenid> pp_directive_lookup = {
+static constexpr keyword pp_directive_list[] = {
 	{ "define", tokenid::hash_def },
 	{ "undef", tokenid::hash_undef },
 	{ "if", tokenid::hash_if },
@@ -337,6 +558,9 @@ static const std::unordered_map<std::string, tokenid> pp_directive_lookup = {
 	{ "include", tokenid::hash_include },
 };
 
+static constexpr keyword_table<1024> keyword_lookup(keyword_list);
+static constexpr keyword_table<64> pp_directive_lookup(pp_directive_list);
+
 inline bool is_octal_digit(char c)
 {
 	return static_cast<unsigned>(c - '0') < 8;
@@ -392,10 +616,16 @@ std::string reshadefx::token::id_to_name(tokenid id)
 }
 
 reshadefx::token reshadefx::lexer::lex()
+{
+	token tok;
+	lex(tok);
+	return tok;
+}
+
+void reshadefx::lexer::lex(token &tok)
 {
 	bool is_at_line_begin = _cur_location.column <= 1;
 
-	token tok;
 next_token:
 	// Reset token data
 	tok.location = _cur_location;
@@ -409,14 +639,14 @@ next_token:
 	{
 	case 0xFF: // EOF
 		tok.id = tokenid::end_of_file;
-		return tok;
+		return;
 	case SPACE:
 		skip_space();
 		if (_ignore_whitespace || is_at_line_begin || *_cur == '\n')
 			goto next_token;
 		tok.id = tokenid::space;
 		tok.length = _cur - _input.data() - tok.offset;
-		return tok;
+		return;
 	case '\n':
 		_cur++;
 		_cur_location.line++;
@@ -425,7 +655,7 @@ next_token:
 		if (_ignore_whitespace)
 			goto next_token;
 		tok.id = tokenid::end_of_line;
-		return tok;
+		return;
 	case DIGIT:
 		parse_numeric_literal(tok);
 		break;
@@ -445,11 +675,15 @@ next_token:
 	case '#':
 		if (is_at_line_begin)
 		{
-			if (!parse_pp_directive(tok) || _ignore_pp_directives)
+			if (!parse_pp_directive(tok) || (_ignore_pp_directives && tok.id != tokenid::hash_pragma))
 			{
 				skip_to_next_line();
 				goto next_token;
 			}
+
+			// Pragmas may affect how the code is parsed, so they are returned with the rest of the line as literal even when other directives are ignored
+			if (_ignore_pp_directives)
+				parse_pragma_arguments(tok);
 		} // These braces are important so the 'else' is matched to the right 'if' statement
 		else
 		tok.id = tokenid::hash;
@@ -530,18 +764,23 @@ next_token:
 				goto next_token;
 			tok.id = tokenid::single_line_comment;
 			tok.length = _cur - _input.data() - tok.offset;
-			return tok;
+			return;
 		}
 		else if (_cur[1] == '*')
 		{
 			while (_cur < _end)
 			{
+				// Jump straight to the next character that can end the comment or start a new line
+				skip(find_first<line_feed_or_star_char>(_cur, _end) - _cur);
+				if (_cur >= _end)
+					break;
+
 				if (*_cur == '\n')
 				{
 					_cur_location.line++;
 					_cur_location.column = 1;
 				}
-				else if (_cur[0] == '*' && _cur[1] == '/')
+				else if (_cur[1] == '/')
 				{
 					skip(2);
 					break;
@@ -552,7 +791,7 @@ next_token:
 				goto next_token;
 			tok.id = tokenid::multi_line_comment;
 			tok.length = _cur - _input.data() - tok.offset;
-			return tok;
+			return;
 		}
 		else if (_cur[1] == '=')
 			tok.id = tokenid::slash_equal,
@@ -652,8 +891,6 @@ next_token:
 	}
 
 	skip(tok.length);
-
-	return tok;
 }
 
 void reshadefx::lexer::skip(size_t length)
@@ -663,23 +900,21 @@ void reshadefx::lexer::skip(size_t length)
 }
 void reshadefx::lexer::skip_space()
 {
-	// Skip each character until a space is found
-	while (type_lookup[*_cur] == SPACE && _cur < _end)
-		skip(1);
+	// Skip each character until a non-space character is found
+	skip(find_first<not_space_char>(_cur, _end) - _cur);
 }
 void reshadefx::lexer::skip_to_next_line()
 {
 	// Skip each character until a new line feed is found
-	while (*_cur != '\n' && _cur < _end)
-		skip(1);
+	skip(find_first<line_feed_char>(_cur, _end) - _cur);
 }
 
 void reshadefx::lexer::parse_identifier(token &tok) const
 {
-	auto *const begin = _cur, *end = begin;
+	auto *const begin = _cur;
 
-	// Skip to the end of the identifier sequence
-	do end++; while (type_lookup[*end] == IDENT || type_lookup[*end] == DIGIT);
+	// Skip to the end of the identifier sequence (the first character is always part of it)
+	auto *const end = find_first<not_identifier_char>(begin + 1, _end);
 
 	tok.id = tokenid::identifier;
 	tok.offset = begin - _input.data();
@@ -689,12 +924,7 @@ void reshadefx::lexer::parse_identifier(token &tok) const
 	if (_ignore_keywords)
 		return;
 
-	const auto it = keyword_lookup.find(tok.literal_as_string);
-
-	if (it != keyword_lookup.end())
-	{
-		tok.id = it->second;
-	}
+	keyword_lookup.find(begin, tok.length, tok.id);
 }
 bool reshadefx::lexer::parse_pp_directive(token &tok)
 {
@@ -702,12 +932,8 @@ bool reshadefx::lexer::parse_pp_directive(token &tok)
 	skip_space(); // Skip any space between the '#' and directive
 	parse_identifier(tok);
 
-	const auto it = pp_directive_lookup.find(tok.literal_as_string);
-
-	if (it != pp_directive_lookup.end())
+	if (pp_directive_lookup.find(tok.literal_as_string.data(), tok.literal_as_string.size(), tok.id))
 	{
-		tok.id = it->second;
-
 		return true;
 	}
 	else if (!_ignore_line_directives && tok.literal_as_string == "line") // The #line directive needs special handling
@@ -731,7 +957,7 @@ bool reshadefx::lexer::parse_pp_directive(token &tok)
 			token temptok;
 			parse_string_literal(temptok, false);
 
-			_cur_location.source = std::move(temptok.literal_as_string);
+			_cur_location.source = location::intern_source(temptok.literal_as_string);
 		}
 
 		// Do not return the #line directive as token to the caller
@@ -742,6 +968,25 @@ bool reshadefx::lexer::parse_pp_directive(token &tok)
 
 	return true;
 }
+
+void reshadefx::lexer::parse_pragma_arguments(token &tok)
+{
+	skip(tok.length); // Skip the 'pragma' identifier
+	skip_space();
+
+	auto *const begin = _cur;
+	auto *end = find_first<line_feed_char>(begin, _end);
+
+	tok.offset = begin - _input.data();
+	tok.length = end - begin;
+
+	// Trim trailing whitespace (like a carriage return)
+	while (end > begin && type_lookup[static_cast<uint8_t>(end[-1])] == SPACE)
+		--end;
+
+	tok.literal_as_string.assign(begin, end);
+}
+
 void reshadefx::lexer::parse_string_literal(token &tok, bool escape) const
 {
 	auto *const begin = _cur, *end = begin + 1;
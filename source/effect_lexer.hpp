@@ -6,6 +6,7 @@
 #pragma once
 
 #include "effect_expression.hpp"
+#include <string_view>
 
 namespace reshadefx
 {
@@ -145,6 +146,13 @@ namespace reshadefx
 		float2x2,
 		float3x3,
 		float4x4,
+		min16float,
+		min16float2,
+		min16float3,
+		min16float4,
+		min16float2x2,
+		min16float3x3,
+		min16float4x4,
 		vector,
 		matrix,
 		string_,
@@ -235,17 +243,59 @@ namespace reshadefx
 			return *this;
 		}
 
+		/// <summary>
+		/// A snapshot of the current lexer position, which can be used to rewind the lexer to that point again later on.
+		/// </summary>
+		struct checkpoint
+		{
+			size_t offset;
+			location location;
+		};
+
+		/// <summary>
+		/// Save the current position in the input string. This is cheap, since the input string is not copied.
+		/// </summary>
+		/// <returns>A checkpoint to pass to <see cref="restore_checkpoint"/>.</returns>
+		checkpoint save_checkpoint() const { return { static_cast<size_t>(_cur - _input.data()), _cur_location }; }
+		/// <summary>
+		/// Rewind to a position previously saved with <see cref="save_checkpoint"/>.
+		/// </summary>
+		/// <param name="checkpoint">The checkpoint to restore.</param>
+		void restore_checkpoint(const checkpoint &checkpoint)
+		{
+			_cur = _input.data() + checkpoint.offset;
+			_cur_location = checkpoint.location;
+		}
+
 		/// <summary>
 		/// Get the input string this lexical analyzer works on.
 		/// </summary>
 		/// <returns>A constant reference to the input string.</returns>
 		const std::string &input_string() const { return _input; }
 
+		/// <summary>
+		/// Replace the input string and start over at the beginning of it, keeping all other settings.
+		/// This reuses the memory of the previous input string where possible, so is cheaper than creating a new lexer.
+		/// </summary>
+		/// <param name="input">The new string to perform lexical analysis on.</param>
+		void reset(std::string_view input)
+		{
+			_input.assign(input.data(), input.size());
+			_cur_location = location();
+			_cur = _input.data();
+			_end = _cur + _input.size();
+		}
+
 		/// <summary>
 		/// Perform lexical analysis on the input string and return the next token in sequence.
 		/// </summary>
 		/// <returns>The next token from the input string.</returns>
 		token lex();
+		/// <summary>
+		/// Perform lexical analysis on the input string and store the next token in sequence in an existing token structure.
+		/// </summary>
+		/// <param name="tok">The token structure to fill in. Its string storage is reused.</param>
+		void lex(token &tok);
 
 		/// <summary>
 		/// Advances to the next token that is not whitespace.
@@ -265,6 +315,7 @@ namespace reshadefx
 
 		void parse_identifier(token &tok) const;
 		bool parse_pp_directive(token &tok);
+		void parse_pragma_arguments(token &tok);
 		void parse_string_literal(token &tok, bool escape) const;
 		void parse_numeric_literal(token &tok) const;
 
@@ -0,0 +1,555 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "effect_module.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Increment the version whenever the layout of any of the records below changes, so that old data is rejected
+static const uint32_t module_magic = 0x4D465852; // "RXFM" (in little-endian byte order, so big-endian data is rejected as well)
+static const uint32_t module_version = 3;
+
+// All records consist of 32-bit fields only (or groups of four bytes), so they have no padding and can be read in place from 4-byte aligned data
+
+namespace
+{
+	struct string_ref
+	{
+		uint32_t offset, length; // Range in the string pool
+	};
+	struct index_range
+	{
+		uint32_t first, count; // Range of records in one of the tables
+	};
+	struct table_ref
+	{
+		uint32_t offset, count; // Offset in bytes from the start of the data and number of records (or bytes for the string pool)
+	};
+
+	struct type_record
+	{
+		uint32_t base, rows, cols, qualifiers;
+		int32_t array_length;
+		uint32_t definition;
+	};
+	struct constant_record
+	{
+		uint32_t as_uint[16];
+		string_ref string_data;
+		index_range array_data; // Always located after this record in the constant table
+	};
+	struct annotation_record
+	{
+		string_ref name;
+		type_record type;
+		uint32_t value; // Index in the constant table
+	};
+	struct texture_record
+	{
+		uint32_t id, binding;
+		string_ref semantic, unique_name;
+		index_range annotations;
+		uint32_t width, height, levels, format;
+	};
+	struct sampler_record
+	{
+		uint32_t id, binding, texture_binding;
+		string_ref unique_name, texture_name;
+		index_range annotations;
+		uint32_t filter, address_u, address_v, address_w;
+		float min_lod, max_lod, lod_bias;
+		uint32_t srgb;
+	};
+	struct uniform_record
+	{
+		string_ref name;
+		type_record type;
+		uint32_t size, offset;
+		index_range annotations;
+		uint32_t has_initializer_value;
+		uint32_t initializer_value; // Index in the constant table
+	};
+	struct pass_record
+	{
+		string_ref render_target_names[8], vs_entry_point, ps_entry_point;
+		uint8_t clear_render_targets, srgb_write_enable, blend_enable, stencil_enable, color_write_mask, stencil_read_mask, stencil_write_mask, reserved;
+		uint32_t blend_op, blend_op_alpha, src_blend, dest_blend, src_blend_alpha, dest_blend_alpha;
+		uint32_t stencil_comparison_func, stencil_reference_value, stencil_op_pass, stencil_op_fail, stencil_op_depth_fail;
+		uint32_t num_vertices, viewport_width, viewport_height;
+	};
+	struct technique_record
+	{
+		string_ref name;
+		index_range passes, annotations;
+	};
+	struct entry_point_record
+	{
+		string_ref name;
+		uint32_t is_pixel_shader;
+		string_ref assembly;
+		string_ref code;
+	};
+
+	// The data starts with this header, followed by all the tables it references
+	struct module_header
+	{
+		uint32_t magic, version, size;
+		string_ref hlsl;
+		uint32_t num_sampler_bindings, num_texture_bindings;
+		table_ref spirv, textures, samplers, uniforms, spec_constants, techniques, passes, entry_points, annotations, constants, strings;
+	};
+
+	class module_writer
+	{
+	public:
+		std::vector<texture_record> textures;
+		std::vector<sampler_record> samplers;
+		std::vector<uniform_record> uniforms, spec_constants;
+		std::vector<technique_record> techniques;
+		std::vector<pass_record> passes;
+		std::vector<entry_point_record> entry_points;
+		std::vector<annotation_record> annotations;
+		std::vector<constant_record> constants;
+		std::string strings;
+
+		string_ref add_string(const std::string &value)
+		{
+			// Names (especially those of annotations) repeat a lot, so only store each string once
+			const auto it = _string_lookup.find(value);
+			if (it != _string_lookup.end())
+				return it->second;
+
+			const string_ref ref = { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(value.size()) };
+			strings += value;
+			_string_lookup.emplace(value, ref);
+			return ref;
+		}
+
+		static type_record make_type(const reshadefx::type &type)
+		{
+			return { type.base, type.rows, type.cols, type.qualifiers, type.array_length, type.definition };
+		}
+
+		uint32_t add_constant(const reshadefx::constant &value)
+		{
+			const uint32_t index = static_cast<uint32_t>(constants.size());
+			constants.emplace_back();
+			set_constant(index, value);
+			return index;
+		}
+		void set_constant(uint32_t index, const reshadefx::constant &value)
+		{
+			// Reserve the records of all elements first, so that they are next to each other, before filling them in (which may add more records for nested arrays)
+			const index_range array_data = { static_cast<uint32_t>(constants.size()), static_cast<uint32_t>(value.array_data.size()) };
+			constants.resize(constants.size() + value.array_data.size());
+
+			constant_record &record = constants[index];
+			std::memcpy(record.as_uint, value.as_uint, sizeof(record.as_uint));
+			record.string_data = add_string(value.string_data);
+			record.array_data = array_data;
+
+			for (uint32_t i = 0; i < array_data.count; ++i)
+				set_constant(array_data.first + i, value.array_data[i]);
+		}
+
+		index_range add_annotations(const std::unordered_map<std::string, std::pair<reshadefx::type, reshadefx::constant>> &map)
+		{
+			// Sort by name, so that the output does not depend on the iteration order of the map
+			std::vector<const std::pair<const std::string, std::pair<reshadefx::type, reshadefx::constant>> *> sorted;
+			sorted.reserve(map.size());
+			for (const auto &annotation : map)
+				sorted.push_back(&annotation);
+			std::sort(sorted.begin(), sorted.end(), [](const auto *lhs, const auto *rhs) { return lhs->first < rhs->first; });
+
+			const index_range range = { static_cast<uint32_t>(annotations.size()), static_cast<uint32_t>(sorted.size()) };
+			for (const auto *annotation : sorted)
+			{
+				annotation_record record;
+				record.name = add_string(annotation->first);
+				record.type = make_type(annotation->second.first);
+				record.value = add_constant(annotation->second.second);
+				annotations.push_back(record);
+			}
+			return range;
+		}
+
+		uniform_record make_uniform(const reshadefx::uniform_info &info)
+		{
+			uniform_record record;
+			record.name = add_string(info.name);
+			record.type = make_type(info.type);
+			record.size = info.size;
+			record.offset = info.offset;
+			record.annotations = add_annotations(info.annotations);
+			record.has_initializer_value = info.has_initializer_value;
+			record.initializer_value = add_constant(info.initializer_value);
+			return record;
+		}
+
+	private:
+		std::unordered_map<std::string, string_ref> _string_lookup;
+	};
+
+	class module_reader
+	{
+	public:
+		explicit module_reader(std::string_view data) : _data(data) {}
+
+		bool read_header(module_header &header) const
+		{
+			if (_data.size() < sizeof(header))
+				return false;
+			std::memcpy(&header, _data.data(), sizeof(header));
+			return header.magic == module_magic && header.version == module_version && header.size == _data.size();
+		}
+
+		template <typename T>
+		bool check_table(const table_ref &table, size_t element_size = sizeof(T)) const
+		{
+			return table.offset % 4 == 0 && table.offset <= _data.size() && table.count <= (_data.size() - table.offset) / element_size;
+		}
+		template <typename T>
+		T get(const table_ref &table, uint32_t index) const
+		{
+			T record;
+			std::memcpy(&record, _data.data() + table.offset + index * sizeof(T), sizeof(T));
+			return record;
+		}
+
+		bool check(const index_range &range, const table_ref &table) const
+		{
+			return range.first <= table.count && range.count <= table.count - range.first;
+		}
+		bool read(const string_ref &ref, std::string &value) const
+		{
+			if (ref.offset > _strings.count || ref.length > _strings.count - ref.offset)
+				return false;
+			value.assign(_data.data() + _strings.offset + ref.offset, ref.length);
+			return true;
+		}
+		bool read(const type_record &record, reshadefx::type &type) const
+		{
+			if (record.base > reshadefx::type::t_function)
+				return false;
+			type.base = static_cast<reshadefx::type::datatype>(record.base);
+			type.rows = record.rows;
+			type.cols = record.cols;
+			type.qualifiers = record.qualifiers;
+			type.array_length = record.array_length;
+			type.definition = record.definition;
+			return true;
+		}
+		bool read_constant(uint32_t index, reshadefx::constant &value) const
+		{
+			if (index >= _constants.count)
+				return false;
+
+			const constant_record record = get<constant_record>(_constants, index);
+			std::memcpy(value.as_uint, record.as_uint, sizeof(value.as_uint));
+			if (!read(record.string_data, value.string_data))
+				return false;
+
+			// Elements are always stored after their array, which guarantees this terminates even for corrupted data
+			if (!check(record.array_data, _constants) || (record.array_data.count != 0 && record.array_data.first <= index))
+				return false;
+			value.array_data.resize(record.array_data.count);
+			for (uint32_t i = 0; i < record.array_data.count; ++i)
+				if (!read_constant(record.array_data.first + i, value.array_data[i]))
+					return false;
+			return true;
+		}
+		bool read_annotations(const index_range &range, std::unordered_map<std::string, std::pair<reshadefx::type, reshadefx::constant>> &map) const
+		{
+			if (!check(range, _annotations))
+				return false;
+
+			std::string name;
+			for (uint32_t i = 0; i < range.count; ++i)
+			{
+				const annotation_record record = get<annotation_record>(_annotations, range.first + i);
+				if (!read(record.name, name))
+					return false;
+				auto &value = map[name];
+				if (!read(record.type, value.first) || !read_constant(record.value, value.second))
+					return false;
+			}
+			return true;
+		}
+		bool read_uniform(const uniform_record &record, reshadefx::uniform_info &info) const
+		{
+			info.size = record.size;
+			info.offset = record.offset;
+			info.has_initializer_value = record.has_initializer_value != 0;
+			return read(record.name, info.name) && read(record.type, info.type) &&
+				read_annotations(record.annotations, info.annotations) && read_constant(record.initializer_value, info.initializer_value);
+		}
+
+		table_ref _strings = {}, _constants = {}, _annotations = {};
+
+	private:
+		std::string_view _data;
+	};
+}
+
+void reshadefx::write_module(const module &module, std::string &data)
+{
+	module_writer writer;
+
+	module_header header = {};
+	header.magic = module_magic;
+	header.version = module_version;
+	header.hlsl = writer.add_string(module.hlsl);
+	header.num_sampler_bindings = module.num_sampler_bindings;
+	header.num_texture_bindings = module.num_texture_bindings;
+
+	for (const texture_info &info : module.textures)
+	{
+		texture_record record;
+		record.id = info.id;
+		record.binding = info.binding;
+		record.semantic = writer.add_string(info.semantic);
+		record.unique_name = writer.add_string(info.unique_name);
+		record.annotations = writer.add_annotations(info.annotations);
+		record.width = info.width;
+		record.height = info.height;
+		record.levels = info.levels;
+		record.format = static_cast<uint32_t>(info.format);
+		writer.textures.push_back(record);
+	}
+
+	for (const sampler_info &info : module.samplers)
+	{
+		sampler_record record;
+		record.id = info.id;
+		record.binding = info.binding;
+		record.texture_binding = info.texture_binding;
+		record.unique_name = writer.add_string(info.unique_name);
+		record.texture_name = writer.add_string(info.texture_name);
+		record.annotations = writer.add_annotations(info.annotations);
+		record.filter = static_cast<uint32_t>(info.filter);
+		record.address_u = static_cast<uint32_t>(info.address_u);
+		record.address_v = static_cast<uint32_t>(info.address_v);
+		record.address_w = static_cast<uint32_t>(info.address_w);
+		record.min_lod = info.min_lod;
+		record.max_lod = info.max_lod;
+		record.lod_bias = info.lod_bias;
+		record.srgb = info.srgb;
+		writer.samplers.push_back(record);
+	}
+
+	for (const uniform_info &info : module.uniforms)
+		writer.uniforms.push_back(writer.make_uniform(info));
+	for (const uniform_info &info : module.spec_constants)
+		writer.spec_constants.push_back(writer.make_uniform(info));
+
+	for (const technique_info &info : module.techniques)
+	{
+		technique_record record;
+		record.name = writer.add_string(info.name);
+		record.passes = { static_cast<uint32_t>(writer.passes.size()), static_cast<uint32_t>(info.passes.size()) };
+		record.annotations = writer.add_annotations(info.annotations);
+		writer.techniques.push_back(record);
+
+		for (const pass_info &pass : info.passes)
+		{
+			pass_record &pass_data = writer.passes.emplace_back();
+			for (int i = 0; i < 8; ++i)
+				pass_data.render_target_names[i] = writer.add_string(pass.render_target_names[i]);
+			pass_data.vs_entry_point = writer.add_string(pass.vs_entry_point);
+			pass_data.ps_entry_point = writer.add_string(pass.ps_entry_point);
+			pass_data.clear_render_targets = pass.clear_render_targets;
+			pass_data.srgb_write_enable = pass.srgb_write_enable;
+			pass_data.blend_enable = pass.blend_enable;
+			pass_data.stencil_enable = pass.stencil_enable;
+			pass_data.color_write_mask = pass.color_write_mask;
+			pass_data.stencil_read_mask = pass.stencil_read_mask;
+			pass_data.stencil_write_mask = pass.stencil_write_mask;
+			pass_data.reserved = 0;
+			pass_data.blend_op = pass.blend_op;
+			pass_data.blend_op_alpha = pass.blend_op_alpha;
+			pass_data.src_blend = pass.src_blend;
+			pass_data.dest_blend = pass.dest_blend;
+			pass_data.src_blend_alpha = pass.src_blend_alpha;
+			pass_data.dest_blend_alpha = pass.dest_blend_alpha;
+			pass_data.stencil_comparison_func = pass.stencil_comparison_func;
+			pass_data.stencil_reference_value = pass.stencil_reference_value;
+			pass_data.stencil_op_pass = pass.stencil_op_pass;
+			pass_data.stencil_op_fail = pass.stencil_op_fail;
+			pass_data.stencil_op_depth_fail = pass.stencil_op_depth_fail;
+			pass_data.num_vertices = pass.num_vertices;
+			pass_data.viewport_width = pass.viewport_width;
+			pass_data.viewport_height = pass.viewport_height;
+		}
+	}
+
+	for (const entry_point_info &info : module.entry_points)
+	{
+		entry_point_record record;
+		record.name = writer.add_string(info.name);
+		record.is_pixel_shader = info.is_pixel_shader;
+		record.assembly = writer.add_string(info.assembly);
+		record.code = writer.add_string(info.code);
+		writer.entry_points.push_back(record);
+	}
+
+	// Lay out all tables one after another behind the header
+	data.assign(sizeof(header), '\0');
+
+	const auto append_table = [&data](const void *elements, size_t count, size_t element_size) {
+		const table_ref table = { static_cast<uint32_t>(data.size()), static_cast<uint32_t>(count) };
+		data.append(static_cast<const char *>(elements), count * element_size);
+		return table;
+	};
+
+	header.spirv = append_table(module.spirv.data(), module.spirv.size(), sizeof(uint32_t));
+	header.textures = append_table(writer.textures.data(), writer.textures.size(), sizeof(texture_record));
+	header.samplers = append_table(writer.samplers.data(), writer.samplers.size(), sizeof(sampler_record));
+	header.uniforms = append_table(writer.uniforms.data(), writer.uniforms.size(), sizeof(uniform_record));
+	header.spec_constants = append_table(writer.spec_constants.data(), writer.spec_constants.size(), sizeof(uniform_record));
+	header.techniques = append_table(writer.techniques.data(), writer.techniques.size(), sizeof(technique_record));
+	header.passes = append_table(writer.passes.data(), writer.passes.size(), sizeof(pass_record));
+	header.entry_points = append_table(writer.entry_points.data(), writer.entry_points.size(), sizeof(entry_point_record));
+	header.annotations = append_table(writer.annotations.data(), writer.annotations.size(), sizeof(annotation_record));
+	header.constants = append_table(writer.constants.data(), writer.constants.size(), sizeof(constant_record));
+	header.strings = append_table(writer.strings.data(), writer.strings.size(), 1);
+
+	header.size = static_cast<uint32_t>(data.size());
+	std::memcpy(data.data(), &header, sizeof(header));
+}
+
+bool reshadefx::read_module(std::string_view data, module &module)
+{
+	const module_reader reader_header(data);
+
+	module_header header;
+	if (!reader_header.read_header(header))
+		return false;
+
+	if (!reader_header.check_table<uint32_t>(header.spirv) ||
+		!reader_header.check_table<texture_record>(header.textures) ||
+		!reader_header.check_table<sampler_record>(header.samplers) ||
+		!reader_header.check_table<uniform_record>(header.uniforms) ||
+		!reader_header.check_table<uniform_record>(header.spec_constants) ||
+		!reader_header.check_table<technique_record>(header.techniques) ||
+		!reader_header.check_table<pass_record>(header.passes) ||
+		!reader_header.check_table<entry_point_record>(header.entry_points) ||
+		!reader_header.check_table<annotation_record>(header.annotations) ||
+		!reader_header.check_table<constant_record>(header.constants) ||
+		!reader_header.check_table<char>(header.strings, 1) || header.strings.offset % 4 != 0)
+		return false;
+
+	module_reader reader(data);
+	reader._strings = header.strings;
+	reader._constants = header.constants;
+	reader._annotations = header.annotations;
+
+	if (!reader.read(header.hlsl, module.hlsl))
+		return false;
+
+	module.spirv.resize(header.spirv.count);
+	if (header.spirv.count != 0) // Passing a null pointer to 'memcpy' is not allowed, even if the size is zero
+		std::memcpy(module.spirv.data(), data.data() + header.spirv.offset, header.spirv.count * sizeof(uint32_t));
+
+	module.num_sampler_bindings = header.num_sampler_bindings;
+	module.num_texture_bindings = header.num_texture_bindings;
+
+	module.textures.resize(header.textures.count);
+	for (uint32_t i = 0; i < header.textures.count; ++i)
+	{
+		const texture_record record = reader.get<texture_record>(header.textures, i);
+		texture_info &info = module.textures[i];
+		info.id = record.id;
+		info.binding = record.binding;
+		info.width = record.width;
+		info.height = record.height;
+		info.levels = record.levels;
+		info.format = static_cast<texture_format>(record.format);
+		if (!reader.read(record.semantic, info.semantic) || !reader.read(record.unique_name, info.unique_name) || !reader.read_annotations(record.annotations, info.annotations))
+			return false;
+	}
+
+	module.samplers.resize(header.samplers.count);
+	for (uint32_t i = 0; i < header.samplers.count; ++i)
+	{
+		const sampler_record record = reader.get<sampler_record>(header.samplers, i);
+		sampler_info &info = module.samplers[i];
+		info.id = record.id;
+		info.binding = record.binding;
+		info.texture_binding = record.texture_binding;
+		info.filter = static_cast<texture_filter>(record.filter);
+		info.address_u = static_cast<texture_address_mode>(record.address_u);
+		info.address_v = static_cast<texture_address_mode>(record.address_v);
+		info.address_w = static_cast<texture_address_mode>(record.address_w);
+		info.min_lod = record.min_lod;
+		info.max_lod = record.max_lod;
+		info.lod_bias = record.lod_bias;
+		info.srgb = static_cast<uint8_t>(record.srgb);
+		if (!reader.read(record.unique_name, info.unique_name) || !reader.read(record.texture_name, info.texture_name) || !reader.read_annotations(record.annotations, info.annotations))
+			return false;
+	}
+
+	module.uniforms.resize(header.uniforms.count);
+	for (uint32_t i = 0; i < header.uniforms.count; ++i)
+		if (!reader.read_uniform(reader.get<uniform_record>(header.uniforms, i), module.uniforms[i]))
+			return false;
+	module.spec_constants.resize(header.spec_constants.count);
+	for (uint32_t i = 0; i < header.spec_constants.count; ++i)
+		if (!reader.read_uniform(reader.get<uniform_record>(header.spec_constants, i), module.spec_constants[i]))
+			return false;
+
+	module.techniques.resize(header.techniques.count);
+	for (uint32_t i = 0; i < header.techniques.count; ++i)
+	{
+		const technique_record record = reader.get<technique_record>(header.techniques, i);
+		technique_info &info = module.techniques[i];
+		if (!reader.read(record.name, info.name) || !reader.read_annotations(record.annotations, info.annotations) || !reader.check(record.passes, header.passes))
+			return false;
+
+		info.passes.resize(record.passes.count);
+		for (uint32_t k = 0; k < record.passes.count; ++k)
+		{
+			const pass_record pass_data = reader.get<pass_record>(header.passes, record.passes.first + k);
+			pass_info &pass = info.passes[k];
+			for (int t = 0; t < 8; ++t)
+				if (!reader.read(pass_data.render_target_names[t], pass.render_target_names[t]))
+					return false;
+			if (!reader.read(pass_data.vs_entry_point, pass.vs_entry_point) || !reader.read(pass_data.ps_entry_point, pass.ps_entry_point))
+				return false;
+			pass.clear_render_targets = pass_data.clear_render_targets;
+			pass.srgb_write_enable = pass_data.srgb_write_enable;
+			pass.blend_enable = pass_data.blend_enable;
+			pass.stencil_enable = pass_data.stencil_enable;
+			pass.color_write_mask = pass_data.color_write_mask;
+			pass.stencil_read_mask = pass_data.stencil_read_mask;
+			pass.stencil_write_mask = pass_data.stencil_write_mask;
+			pass.blend_op = pass_data.blend_op;
+			pass.blend_op_alpha = pass_data.blend_op_alpha;
+			pass.src_blend = pass_data.src_blend;
+			pass.dest_blend = pass_data.dest_blend;
+			pass.src_blend_alpha = pass_data.src_blend_alpha;
+			pass.dest_blend_alpha = pass_data.dest_blend_alpha;
+			pass.stencil_comparison_func = pass_data.stencil_comparison_func;
+			pass.stencil_reference_value = pass_data.stencil_reference_value;
+			pass.stencil_op_pass = pass_data.stencil_op_pass;
+			pass.stencil_op_fail = pass_data.stencil_op_fail;
+			pass.stencil_op_depth_fail = pass_data.stencil_op_depth_fail;
+			pass.num_vertices = pass_data.num_vertices;
+			pass.viewport_width = pass_data.viewport_width;
+			pass.viewport_height = pass_data.viewport_height;
+		}
+	}
+
+	module.entry_points.resize(header.entry_points.count);
+	for (uint32_t i = 0; i < header.entry_points.count; ++i)
+	{
+		const entry_point_record record = reader.get<entry_point_record>(header.entry_points, i);
+		entry_point_info &info = module.entry_points[i];
+		info.is_pixel_shader = record.is_pixel_shader != 0;
+		if (!reader.read(record.name, info.name) || !reader.read(record.assembly, info.assembly) || !reader.read(record.code, info.code))
+			return false;
+	}
+
+	return true;
+}
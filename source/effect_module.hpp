@@ -0,0 +1,29 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include "effect_expression.hpp"
+#include <string_view>
+
+namespace reshadefx
+{
+	/// <summary>
+	/// Write a module to a compact binary representation, which can be stored and loaded again later with <see cref="read_module"/>.
+	/// The format is versioned and little-endian. All strings are kept in a single pool and all lists are tables of fixed-size records that reference each other by index, so it can be accessed in place (e.g. when memory mapped).
+	/// The same module always results in the same data.
+	/// </summary>
+	/// <param name="module">The module to write.</param>
+	/// <param name="data">The string to store the binary representation in.</param>
+	void write_module(const module &module, std::string &data);
+
+	/// <summary>
+	/// Read a module from the binary representation produced by <see cref="write_module"/>.
+	/// </summary>
+	/// <param name="data">The binary representation to read. It is fully validated, so may come from an untrusted source.</param>
+	/// <param name="module">The target module to fill.</param>
+	/// <returns><c>true</c> on success, or <c>false</c> if the data is not a valid module or was written by a different version.</returns>
+	bool read_module(std::string_view data, module &module);
+}
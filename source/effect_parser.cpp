@@ -20,7 +20,8 @@ struct on_scope_exit
 bool reshadefx::parser::parse(std::string input, codegen *backend)
 {
 	_lexer.reset(new lexer(std::move(input)));
-	_lexer_backup.reset();
+	_lexer_backup = _lexer->save_checkpoint();
+	_relaxed_precision = _relaxed_precision_backup = false;
 
 	// Set backend for subsequent code-generation
 	_codegen = backend;
@@ -39,7 +40,7 @@ bool reshadefx::parser::parse(std::string input, codegen *backend)
 
 void reshadefx::parser::error(const location &location, unsigned int code, const std::string &message)
 {
-	_errors += location.source;
+	_errors += location::source_name(location.source);
 	_errors += '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": error";
 	_errors += (code == 0) ? ": " : " X" + std::to_string(code) + ": ";
 	_errors += message;
@@ -47,7 +48,7 @@ void reshadefx::parser::error(const location &location, unsigned int code, const
 }
 void reshadefx::parser::warning(const location &location, unsigned int code, const std::string &message)
 {
-	_errors += location.source;
+	_errors += location::source_name(location.source);
 	_errors += '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": warning";
 	_errors += (code == 0) ? ": " : " X" + std::to_string(code) + ": ";
 	_errors += message;
@@ -58,20 +59,34 @@ void reshadefx::parser::warning(const location &location, unsigned int code, con
 
 void reshadefx::parser::backup()
 {
-	_lexer.swap(_lexer_backup);
-	_lexer.reset(new lexer(*_lexer_backup));
+	// Only save the lexer position instead of copying the entire lexer (and with it the input string)
+	_lexer_backup = _lexer->save_checkpoint();
 	_token_backup = _token_next;
+	// Pragmas that are read ahead while parsing speculatively are read again after a restore, so the precision has to be rewound with the lexer
+	_relaxed_precision_backup = _relaxed_precision;
 }
 void reshadefx::parser::restore()
 {
-	_lexer.swap(_lexer_backup);
+	_lexer->restore_checkpoint(_lexer_backup);
 	_token_next = _token_backup;
+	_relaxed_precision = _relaxed_precision_backup;
 }
 
 void reshadefx::parser::consume()
 {
-	_token = std::move(_token_next);
-	_token_next = _lexer->lex();
+	// Swap instead of moving, so that the string storage of the current token is reused for the next one
+	std::swap(_token, _token_next);
+
+	while (true)
+	{
+		_lexer->lex(_token_next);
+
+		// Pragmas can appear between any two tokens and are not part of the grammar, so handle them right away
+		if (_token_next.id != tokenid::hash_pragma)
+			break;
+
+		parse_pragma();
+	}
 }
 void reshadefx::parser::consume_until(tokenid tokid)
 {
@@ -108,6 +123,9 @@ bool reshadefx::parser::accept_type_class(type &type)
 {
 	type.rows = type.cols = 0;
 
+	// Floating-point types in function bodies default to minimum precision after '#pragma precision(relaxed)'
+	const type::datatype float_base = _relaxed_precision && _codegen->is_in_function() ? type::t_min16float : type::t_float;
+
 	if (peek(tokenid::identifier))
 	{
 		type.base = type::t_struct;
@@ -126,7 +144,7 @@ bool reshadefx::parser::accept_type_class(type &type)
 	}
 	else if (accept(tokenid::vector))
 	{
-		type.base = type::t_float; // Default to float4 unless a type is specified (see below)
+		type.base = float_base; // Default to float4 unless a type is specified (see below)
 		type.rows = 4, type.cols = 1;
 
 		if (accept('<'))
@@ -151,7 +169,7 @@ bool reshadefx::parser::accept_type_class(type &type)
 	}
 	else if (accept(tokenid::matrix))
 	{
-		type.base = type::t_float; // Default to float4x4 unless a type is specified (see below)
+		type.base = float_base; // Default to float4x4 unless a type is specified (see below)
 		type.rows = 4, type.cols = 4;
 
 		if (accept('<'))
@@ -236,17 +254,32 @@ bool reshadefx::parser::accept_type_class(type &type)
 	case tokenid::float2:
 	case tokenid::float3:
 	case tokenid::float4:
-		type.base = type::t_float;
+		type.base = float_base;
 		type.rows = 1 + unsigned int(_token_next.id) - unsigned int(tokenid::float_);
 		type.cols = 1;
 		break;
 	case tokenid::float2x2:
 	case tokenid::float3x3:
 	case tokenid::float4x4:
-		type.base = type::t_float;
+		type.base = float_base;
 		type.rows = 2 + unsigned int(_token_next.id) - unsigned int(tokenid::float2x2);
 		type.cols = type.rows;
 		break;
+	case tokenid::min16float:
+	case tokenid::min16float2:
+	case tokenid::min16float3:
+	case tokenid::min16float4:
+		type.base = type::t_min16float;
+		type.rows = 1 + unsigned int(_token_next.id) - unsigned int(tokenid::min16float);
+		type.cols = 1;
+		break;
+	case tokenid::min16float2x2:
+	case tokenid::min16float3x3:
+	case tokenid::min16float4x4:
+		type.base = type::t_min16float;
+		type.rows = 2 + unsigned int(_token_next.id) - unsigned int(tokenid::min16float2x2);
+		type.cols = type.rows;
+		break;
 	case tokenid::string_:
 		type.base = type::t_string;
 		break;
@@ -830,46 +863,82 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 
 			assert(symbol.function != nullptr);
 
-			std::vector<expression> parameters(arguments.size());
+			// Intrinsics are evaluated at minimum precision if all their non-constant input arguments are, instead of promoting those to full precision
+			bool relaxed_precision = false;
+			if (symbol.op == symbol_type::intrinsic && symbol.type.base == type::t_float)
+			{
+				for (size_t i = 0; i < arguments.size(); ++i)
+				{
+					if (arguments[i].is_constant || symbol.function->parameter_list[i].type.has(type::q_out))
+						continue;
+					relaxed_precision = arguments[i].type.base == type::t_min16float;
+					if (!relaxed_precision)
+						break;
+				}
+
+				if (relaxed_precision)
+					symbol.type.base = type::t_min16float;
+			}
+
+			const auto parameter_type = [&symbol, relaxed_precision](size_t i) {
+				auto param_type = symbol.function->parameter_list[i].type;
+				if (relaxed_precision && param_type.base == type::t_float)
+					param_type.base = type::t_min16float;
+				return param_type;
+			};
 
-			// We need to allocate some temporary variables to pass in and load results from pointer parameters
 			for (size_t i = 0; i < arguments.size(); ++i)
 			{
-				const auto &param_type = symbol.function->parameter_list[i].type;
+				const auto param_type = parameter_type(i);
 
 				if (arguments[i].type.components() > param_type.components())
 					warning(arguments[i].location, 3206, "implicit truncation of vector type");
 
 				arguments[i].add_cast_operation(param_type);
+			}
 
-				if (symbol.op == symbol_type::function || param_type.has(type::q_out))
-				{
-					// All user-defined functions actually accept pointers as arguments, same applies to intrinsics with 'out' parameters
-					const auto temp_variable = _codegen->define_variable(arguments[i].location, param_type);
-					parameters[i].reset_to_lvalue(arguments[i].location, temp_variable, param_type);
-				}
-				else
+			// Math intrinsics with only constant arguments are evaluated at compile time instead, so that no code has to be generated for them
+			if (symbol.op != symbol_type::intrinsic || !exp.evaluate_constant_intrinsic(location, symbol.id, symbol.type, arguments))
+			{
+				std::vector<expression> parameters(arguments.size());
+
+				// We need to allocate some temporary variables to pass in and load results from pointer parameters
+				for (size_t i = 0; i < arguments.size(); ++i)
 				{
-					parameters[i].reset_to_rvalue(arguments[i].location, _codegen->emit_load(arguments[i]), param_type);
+					const auto param_type = parameter_type(i);
+
+					if (symbol.op == symbol_type::function || param_type.has(type::q_out))
+					{
+						// All user-defined functions actually accept pointers as arguments, same applies to intrinsics with 'out' parameters
+						const auto temp_variable = _codegen->define_variable(arguments[i].location, param_type);
+						parameters[i].reset_to_lvalue(arguments[i].location, temp_variable, param_type);
+					}
+					else
+					{
+						parameters[i].reset_to_rvalue(arguments[i].location, _codegen->emit_load(arguments[i]), param_type);
+					}
 				}
-			}
 
-			// Copy in parameters from the argument access chains to parameter variables
-			for (size_t i = 0; i < arguments.size(); ++i)
-				if (parameters[i].is_lvalue && parameters[i].type.has(type::q_in)) // Only do this for pointer parameters as discovered above
-					_codegen->emit_store(parameters[i], _codegen->emit_load(arguments[i]));
+				// Copy in parameters from the argument access chains to parameter variables
+				for (size_t i = 0; i < arguments.size(); ++i)
+					if (parameters[i].is_lvalue && parameters[i].type.has(type::q_in)) // Only do this for pointer parameters as discovered above
+						_codegen->emit_store(parameters[i], _codegen->emit_load(arguments[i]));
 
-			// Check if the call resolving found an intrinsic or function and invoke the corresponding code
-			const auto result = symbol.op == symbol_type::function ?
-				_codegen->emit_call(location, symbol.id, symbol.type, parameters) :
-				_codegen->emit_call_intrinsic(location, symbol.id, symbol.type, parameters);
+				if (symbol.op == symbol_type::function)
+					_codegen->add_reference(symbol.id);
 
-			exp.reset_to_rvalue(location, result, symbol.type);
+				// Check if the call resolving found an intrinsic or function and invoke the corresponding code
+				const auto result = symbol.op == symbol_type::function ?
+					_codegen->emit_call(location, symbol.id, symbol.type, parameters) :
+					_codegen->emit_call_intrinsic(location, symbol.id, symbol.type, parameters);
 
-			// Copy out parameters from parameter variables back to the argument access chains
-			for (size_t i = 0; i < arguments.size(); ++i)
-				if (parameters[i].is_lvalue && parameters[i].type.has(type::q_out)) // Only do this for pointer parameters as discovered above
-					_codegen->emit_store(arguments[i], _codegen->emit_load(parameters[i]));
+				exp.reset_to_rvalue(location, result, symbol.type);
+
+				// Copy out parameters from parameter variables back to the argument access chains
+				for (size_t i = 0; i < arguments.size(); ++i)
+					if (parameters[i].is_lvalue && parameters[i].type.has(type::q_out)) // Only do this for pointer parameters as discovered above
+						_codegen->emit_store(arguments[i], _codegen->emit_load(parameters[i]));
+			}
 		}
 		else if (symbol.op == symbol_type::invalid)
 		{
@@ -879,6 +948,10 @@ bool reshadefx::parser::parse_expression_unary(expression &exp)
 		else if (symbol.op == symbol_type::variable)
 		{
 			assert(symbol.id != 0);
+			// Keep track of which global variables are used (those are always either 'static' or 'uniform', unlike local variables and parameters)
+			if (symbol.type.has(type::q_static) || symbol.type.has(type::q_uniform))
+				_codegen->add_reference(symbol.id);
+
 			// Simply return the pointer to the variable, dereferencing is done on site where necessary
 			exp.reset_to_lvalue(location, symbol.id, symbol.type);
 		}
@@ -1167,6 +1240,10 @@ bool reshadefx::parser::parse_expression_multary(expression &lhs, unsigned int l
 			type type = type::merge(lhs.type, rhs.type);
 			bool is_bool_result = false;
 
+			// Constants do not promote a minimum precision operand to full precision (so that e.g. 'x * 0.5' keeps the precision of 'x')
+			if (type.base == type::t_float && lhs.is_constant != rhs.is_constant && (lhs.is_constant ? rhs : lhs).type.base == type::t_min16float)
+				type.base = type::t_min16float;
+
 			// Do some error checking depending on the operator
 			if (op == tokenid::equal_equal || op == tokenid::exclaim_equal)
 			{
@@ -1301,7 +1378,11 @@ bool reshadefx::parser::parse_expression_multary(expression &lhs, unsigned int l
 				return error(false_exp.location, 3020, "type mismatch between conditional values"), false;
 
 			// Deduce the result base type based on implicit conversion rules
-			const type type = type::merge(true_exp.type, false_exp.type);
+			type type = type::merge(true_exp.type, false_exp.type);
+
+			// Constants do not promote a minimum precision value to full precision here either (see binary operations above)
+			if (type.base == type::t_float && true_exp.is_constant != false_exp.is_constant && (true_exp.is_constant ? false_exp : true_exp).type.base == type::t_min16float)
+				type.base = type::t_min16float;
 
 			if (true_exp.type.components() > type.components())
 				warning(true_exp.location, 3206, "implicit truncation of vector type");
@@ -1427,7 +1508,13 @@ bool reshadefx::parser::parse_annotations(std::unordered_map<std::string, std::p
 		if (expression expression; !expect('=') || !parse_expression_unary(expression) || !expect(';'))
 			return consume_until('>'), false; // Probably a syntax error, so abort parsing
 		else if (expression.is_constant)
+		{
+			// Annotation values are read by the application, which only deals with full precision
+			if (expression.type.base == type::t_min16float)
+				expression.type.base = type::t_float;
+
 			annotations[name] = { expression.type, expression.constant };
+		}
 		else // Continue parsing annotations despite this not being a constant, since the syntax is still correct
 			error(expression.location, 3011, "value must be a literal expression"), parse_success = false;
 	}
@@ -2371,6 +2458,9 @@ bool reshadefx::parser::parse_variable(type type, std::string name, bool global)
 			// It is invalid to make 'uniform' variables constant, since they can be modified externally
 			if (type.has(type::q_const))
 				return error(location, 3035, '\'' + name + "': variables which are 'uniform' cannot be declared 'const'"), false;
+			// Values of uniform variables are provided by the application, which only deals with full precision
+			if (type.base == type::t_min16float)
+				return error(location, 3038, '\'' + name + "': variables which are 'uniform' cannot be of a minimum precision type"), false;
 		}
 	}
 	else
@@ -2753,6 +2843,9 @@ bool reshadefx::parser::parse_technique_pass(pass_info &info)
 					// Look up the matching function info for this function definition
 					function_info &function_info = _codegen->find_function(symbol.id);
 
+					// Entry points are the roots from which the code generator finds all functions that are actually used
+					_codegen->add_reference(symbol.id);
+
 					// We potentially need to generate a special entry point function which translates between function parameters and input/output variables
 					_codegen->define_entry_point(function_info, is_ps);
 
@@ -2872,3 +2965,16 @@ bool reshadefx::parser::parse_technique_pass(pass_info &info)
 
 	return expect('}');
 }
+
+void reshadefx::parser::parse_pragma()
+{
+	std::string pragma = _token_next.literal_as_string;
+	pragma.erase(std::remove_if(pragma.begin(), pragma.end(), [](char c) { return c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r'; }), pragma.end());
+
+	if (pragma == "precision(relaxed)")
+		_relaxed_precision = true;
+	else if (pragma == "precision(full)")
+		_relaxed_precision = false;
+	else
+		warning(_token_next.location, 3568, '\'' + _token_next.literal_as_string + "': unknown pragma ignored");
+}
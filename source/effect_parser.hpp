@@ -76,14 +76,18 @@ namespace reshadefx
 		bool parse_variable(type type, std::string name, bool global = false);
 		bool parse_technique();
 		bool parse_technique_pass(pass_info &info);
+		void parse_pragma();
 
 		std::string _errors;
 		token _token, _token_next, _token_backup;
-		std::unique_ptr<lexer> _lexer, _lexer_backup;
+		std::unique_ptr<lexer> _lexer;
+		lexer::checkpoint _lexer_backup;
 		codegen *_codegen = nullptr;
 
 		std::vector<uint32_t> _loop_break_target_stack;
 		std::vector<uint32_t> _loop_continue_target_stack;
 		type _current_return_type;
+		// Set by '#pragma precision(relaxed)', which makes floating-point types declared in function bodies default to minimum precision
+		bool _relaxed_precision = false, _relaxed_precision_backup = false;
 	};
 }
@@ -5,6 +5,10 @@
 
 #include "effect_preprocessor.hpp"
 #include <assert.h>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <algorithm>
 
 enum macro_replacement
 {
@@ -23,8 +27,17 @@ static bool read_file(const std::filesystem::path &path, std::string &data)
 	if (_wfopen_s(&file, path.c_str(), L"rb") != 0)
 		return false;
 
+	// Use the non-throwing overload, since this may run on a thread other threads wait for (see 'read_file_cached')
+	std::error_code ec;
+	const uintmax_t size = std::filesystem::file_size(path, ec);
+	if (ec)
+	{
+		fclose(file);
+		return false;
+	}
+
 	// Read file contents into memory
-	std::vector<char> mem(static_cast<size_t>(std::filesystem::file_size(path) + 1));
+	std::vector<char> mem(static_cast<size_t>(size + 1));
 	const size_t eof = fread(mem.data(), 1, mem.size() - 1, file);
 
 	// Append a new line feed to the end of the input string to avoid issues with parsing
@@ -46,6 +59,63 @@ static bool read_file(const std::filesystem::path &path, std::string &data)
 	return true;
 }
 
+// Included files are shared between all preprocessor instances (and thus across threads), so that common headers are only read from disk once when loading many effects
+struct cached_file
+{
+	// Only the thread that added the entry reads the file, every other thread looking it up meanwhile waits on this for the result
+	std::shared_future<std::shared_ptr<const std::string>> data;
+	std::filesystem::file_time_type last_write_time;
+};
+
+static std::mutex s_include_cache_mutex;
+static std::unordered_map<std::string, cached_file> s_include_cache;
+static std::atomic<size_t> s_include_cache_hits(0), s_include_cache_misses(0);
+
+static std::shared_ptr<const std::string> read_file_cached(const std::filesystem::path &path)
+{
+	// Any modification of the file invalidates its cache entry, so check the last write time on every lookup
+	std::error_code ec;
+	const std::filesystem::file_time_type last_write_time = std::filesystem::last_write_time(path, ec);
+	if (ec)
+		return nullptr;
+
+	std::promise<std::shared_ptr<const std::string>> promise;
+	std::shared_future<std::shared_ptr<const std::string>> data;
+
+	{
+		const std::lock_guard<std::mutex> lock(s_include_cache_mutex);
+
+		cached_file &file = s_include_cache[path.u8string()];
+		// An entry whose file failed to be read holds no data, so is replaced to try again
+		if (file.data.valid() && file.last_write_time == last_write_time &&
+			(file.data.wait_for(std::chrono::seconds(0)) != std::future_status::ready || file.data.get() != nullptr))
+		{
+			s_include_cache_hits++;
+			data = file.data;
+		}
+		else
+		{
+			s_include_cache_misses++;
+			file.data = promise.get_future().share();
+			file.last_write_time = last_write_time;
+		}
+	}
+
+	// Another thread already is or was reading this file, so wait for it instead of reading the same file again
+	if (data.valid())
+		return data.get();
+
+	// Read without holding the lock, so that threads looking up other files are not blocked by this one
+	std::shared_ptr<const std::string> contents;
+	if (std::string file_data; read_file(path, file_data))
+		// The contents are never modified after this point, so they can safely be shared with all threads
+		contents = std::make_shared<const std::string>(std::move(file_data));
+
+	promise.set_value(contents);
+
+	return contents;
+}
+
 static std::string escape_string(std::string s)
 {
 	for (size_t offset = 0; (offset = s.find('\\', offset)) != std::string::npos; offset += 2)
@@ -81,7 +151,7 @@ bool reshadefx::preprocessor::append_file(const std::filesystem::path &path)
 
 	_success = true; // Clear success flag before parsing a new file
 
-	push(std::move(data), path.u8string());
+	push(data, path.u8string());
 	parse();
 
 	return _success;
@@ -108,99 +178,173 @@ std::vector<std::filesystem::path> reshadefx::preprocessor::included_files() con
 	return files;
 }
 
+std::vector<std::filesystem::path> reshadefx::preprocessor::missing_include_candidates() const
+{
+	std::vector<std::filesystem::path> paths;
+	paths.reserve(_missing_include_candidates.size());
+	for (const std::string &path : _missing_include_candidates)
+		paths.push_back(std::filesystem::u8path(path));
+	return paths;
+}
+
+std::vector<std::string> reshadefx::preprocessor::used_macro_definitions() const
+{
+	return std::vector<std::string>(_used_macros.begin(), _used_macros.end());
+}
+
+size_t reshadefx::preprocessor::include_cache_hits()
+{
+	return s_include_cache_hits;
+}
+size_t reshadefx::preprocessor::include_cache_misses()
+{
+	return s_include_cache_misses;
+}
+void reshadefx::preprocessor::reset_include_cache_statistics()
+{
+	s_include_cache_hits = 0;
+	s_include_cache_misses = 0;
+}
+
 void reshadefx::preprocessor::error(const location &location, const std::string &message)
 {
-	_errors += location.source + '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": preprocessor error: " + message + '\n';
+	_errors += location::source_name(location.source) + '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": preprocessor error: " + message + '\n';
 	_success = false; // Unset success flag
 }
 void reshadefx::preprocessor::warning(const location &location, const std::string &message)
 {
-	_errors += location.source + '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": preprocessor warning: " + message + '\n';
+	_errors += location::source_name(location.source) + '(' + std::to_string(location.line) + ", " + std::to_string(location.column) + ')' + ": preprocessor warning: " + message + '\n';
 }
 
-reshadefx::lexer &reshadefx::preprocessor::current_lexer()
+reshadefx::preprocessor::input_level &reshadefx::preprocessor::current_input()
 {
-	assert(!_input_stack.empty());
+	assert(_input_stack_size != 0);
 
-	return *_input_stack.top().lexer;
+	return _input_stack[_input_stack_size - 1];
+}
+reshadefx::lexer &reshadefx::preprocessor::current_lexer()
+{
+	return *current_input().lexer;
 }
 std::stack<reshadefx::preprocessor::if_level> &reshadefx::preprocessor::current_if_stack()
 {
-	assert(!_input_stack.empty());
-
-	return _input_stack.top().if_stack;
+	return current_input().if_stack;
 }
 
-void reshadefx::preprocessor::push(std::string input, const std::string &name)
+void reshadefx::preprocessor::push(std::string_view input, const std::string &name)
 {
-	input_level level = {};
-	level.name = name;
-	level.lexer.reset(new lexer(std::move(input), true, false, false, false, true, false));
+	// Reuse levels that were pushed and popped before, so that their lexer and string storage does not have to be allocated again for every macro expansion
+	if (_input_stack_size == _input_stack.size())
+		_input_stack.emplace_back().lexer.reset(new lexer(std::string(), true, false, false, false, true, false));
+
+	input_level &level = _input_stack[_input_stack_size];
+	const input_level *const parent = _input_stack_size != 0 ? &_input_stack[_input_stack_size - 1] : nullptr;
+
+	level.lexer->reset(input);
 	level.next_token.id = tokenid::unknown;
+	level.next_token.location = location();
+	level.next_token.offset = 0;
+	level.next_token.length = 0;
+	level.next_token.literal_as_double = 0;
+	level.next_token.literal_as_string.clear();
+	while (!level.if_stack.empty())
+		level.if_stack.pop();
 
-	if (!_input_stack.empty())
-	{
-		level.parent = &_input_stack.top();
-		level.hidden_macros = level.parent->hidden_macros;
-	}
+	// Macros hidden in the parent level stay hidden, which is achieved by sharing its list (new entries are only ever added to the front)
+	level.hidden_macros = parent != nullptr ? parent->hidden_macros : 0;
+	level.hidden_macros_mark = _hidden_macros_size;
+
+	level.include_guard.clear();
 
 	if (name.empty())
 	{
-		if (level.parent != nullptr)
-			level.name = level.parent->name;
+		level.source = parent != nullptr ? parent->source : 0;
+		level.include_guard_state = include_guard_state::none;
 	}
 	else
 	{
-		_output_location.source = name;
+		level.source = location::intern_source(name);
+		level.include_guard_state = include_guard_state::unknown;
+
+		_output_location.source = level.source;
 
 		_output += "#line 1 \"" + name + "\"\n";
 	}
 
-	_input_stack.push(std::move(level));
+	_input_stack_size++;
 
 	consume();
 }
+void reshadefx::preprocessor::pop()
+{
+	// Entries that were added to the hidden macro list since this level was pushed can only be referenced by it, so they are free to be reused now
+	_hidden_macros_size = current_input().hidden_macros_mark;
+
+	_input_stack_size--;
+}
+
+bool reshadefx::preprocessor::is_hidden_macro(const std::string &name) const
+{
+	assert(_input_stack_size != 0);
+
+	for (size_t index = _input_stack[_input_stack_size - 1].hidden_macros; index != 0; index = _hidden_macros[index].next)
+		if (_hidden_macros[index].name == name)
+			return true;
+
+	return false;
+}
+void reshadefx::preprocessor::hide_macro(const std::string &name)
+{
+	if (_hidden_macros_size == _hidden_macros.size())
+		_hidden_macros.emplace_back();
+
+	hidden_macro &entry = _hidden_macros[_hidden_macros_size];
+	entry.name = name;
+	entry.next = current_input().hidden_macros;
+
+	current_input().hidden_macros = _hidden_macros_size++;
+}
 
 bool reshadefx::preprocessor::peek(tokenid token) const
 {
-	assert(!_input_stack.empty());
+	assert(_input_stack_size != 0);
 
-	return _input_stack.top().next_token == token;
+	return _input_stack[_input_stack_size - 1].next_token == token;
 }
 void reshadefx::preprocessor::consume()
 {
-	assert(!_input_stack.empty());
-
-	auto &input_level = _input_stack.top();
+	auto &input_level = current_input();
 	const auto &input_string = input_level.lexer->input_string();
 
-	_token = std::move(input_level.next_token);
+	// Swap instead of moving, so that the string storage of the current token is reused for the next one
+	std::swap(_token, input_level.next_token);
 	_token.location.source = _output_location.source;
-	_current_token_raw_data = input_string.substr(_token.offset, _token.length);
+	_current_token_raw_data.assign(input_string, _token.offset, _token.length);
 
 	// Get the next token
-	input_level.next_token =
-		input_level.lexer->lex();
+	input_level.lexer->lex(input_level.next_token);
 
 	// Pop input level if lexical analysis has reached the end of it
-	while (_input_stack.top().next_token == tokenid::end_of_file)
+	while (current_input().next_token == tokenid::end_of_file)
 	{
 		if (!current_if_stack().empty())
 			error(current_if_stack().top().token.location, "unterminated #if");
 
-		_input_stack.pop();
+		// Remember the include guard of this file, so that including it again can be skipped while the guard macro is defined
+		if (const auto &top = current_input(); top.include_guard_state == include_guard_state::closed)
+			_include_guards.emplace(location::source_name(top.source), top.include_guard);
 
-		if (_input_stack.empty())
-			break;
+		pop();
 
-		const auto &top = _input_stack.top();
+		if (_input_stack_size == 0)
+			break;
 
-		if (top.name != _output_location.source)
+		if (const uint32_t top_source = current_input().source; top_source != _output_location.source)
 		{
 			_output_location.line = 1;
-			_output_location.source = top.name;
+			_output_location.source = top_source;
 
-			_output += "#line 1 \"" + top.name + "\"\n";
+			_output += "#line 1 \"" + location::source_name(top_source) + "\"\n";
 		}
 	}
 }
@@ -231,9 +375,7 @@ bool reshadefx::preprocessor::expect(tokenid token)
 {
 	if (!accept(token))
 	{
-		assert(!_input_stack.empty());
-
-		auto actual_token = _input_stack.top().next_token;
+		auto actual_token = current_input().next_token;
 		actual_token.location.source = _output_location.source;
 
 		error(actual_token.location, "syntax error: unexpected token '" + current_lexer().input_string().substr(actual_token.offset, actual_token.length) + "'");
@@ -248,7 +390,7 @@ void reshadefx::preprocessor::parse()
 {
 	std::string line;
 
-	while (!_input_stack.empty())
+	while (_input_stack_size != 0)
 	{
 		_recursion_count = 0;
 
@@ -256,6 +398,15 @@ void reshadefx::preprocessor::parse()
 
 		consume();
 
+		// Any token outside the first '#ifndef' block of a file means it is not wrapped in an include guard
+		if (_input_stack_size != 0 && _token != tokenid::space && _token != tokenid::end_of_line)
+		{
+			auto &input_level = current_input();
+			if ((input_level.include_guard_state == include_guard_state::unknown && _token != tokenid::hash_ifndef) ||
+				input_level.include_guard_state == include_guard_state::closed)
+				input_level.include_guard_state = include_guard_state::none;
+		}
+
 		switch (_token)
 		{
 		case tokenid::hash_if:
@@ -390,6 +541,9 @@ void reshadefx::preprocessor::parse_def()
 
 	create_macro_replacement_list(m);
 
+	// Whether this is a redefinition depends on the macros defined outside the source too
+	_used_macros.insert(macro_name);
+
 	if (!add_macro_definition(macro_name, m))
 		return error(location, "redefinition of '" + macro_name + "'");
 }
@@ -400,6 +554,7 @@ void reshadefx::preprocessor::parse_undef()
 	else if (_token.literal_as_string == "defined")
 		return warning(_token.location, "macro name 'defined' is reserved");
 
+	_used_macros.insert(_token.literal_as_string);
 	_macros.erase(_token.literal_as_string);
 }
 
@@ -423,6 +578,7 @@ void reshadefx::preprocessor::parse_ifdef()
 	if (!expect(tokenid::identifier))
 		return;
 
+	_used_macros.insert(_token.literal_as_string);
 	level.value = _macros.find(_token.literal_as_string) != _macros.end();
 	level.parent = current_if_stack().empty() ? nullptr : &current_if_stack().top();
 	level.skipping = (level.parent != nullptr && level.parent->skipping) || !level.value;
@@ -437,11 +593,19 @@ void reshadefx::preprocessor::parse_ifndef()
 	if (!expect(tokenid::identifier))
 		return;
 
+	_used_macros.insert(_token.literal_as_string);
 	level.value = _macros.find(_token.literal_as_string) == _macros.end();
 	level.parent = current_if_stack().empty() ? nullptr : &current_if_stack().top();
 	level.skipping = (level.parent != nullptr && level.parent->skipping) || !level.value;
 
 	current_if_stack().push(level);
+
+	// An '#ifndef' as the first directive in a file may be an include guard
+	if (auto &input_level = current_input(); input_level.include_guard_state == include_guard_state::unknown)
+	{
+		input_level.include_guard = _token.literal_as_string;
+		input_level.include_guard_state = include_guard_state::open;
+	}
 }
 void reshadefx::preprocessor::parse_elif()
 {
@@ -453,6 +617,9 @@ void reshadefx::preprocessor::parse_elif()
 	if (level.token == tokenid::hash_else)
 		return error(_token.location, "#elif is not allowed after #else");
 
+	if (current_if_stack().size() == 1 && current_input().include_guard_state == include_guard_state::open)
+		current_input().include_guard_state = include_guard_state::none;
+
 	const bool condition_result = evaluate_expression();
 
 	level.token = _token;
@@ -470,6 +637,9 @@ void reshadefx::preprocessor::parse_else()
 	if (level.token == tokenid::hash_else)
 		return error(_token.location, "#else is not allowed after #else");
 
+	if (current_if_stack().size() == 1 && current_input().include_guard_state == include_guard_state::open)
+		current_input().include_guard_state = include_guard_state::none;
+
 	level.token = _token;
 	level.skipping = (level.parent != nullptr && level.parent->skipping) || level.value;
 
@@ -480,6 +650,9 @@ void reshadefx::preprocessor::parse_endif()
 	if (current_if_stack().empty())
 		return error(_token.location, "missing #if for #endif");
 
+	if (current_if_stack().size() == 1 && current_input().include_guard_state == include_guard_state::open)
+		current_input().include_guard_state = include_guard_state::closed;
+
 	current_if_stack().pop();
 }
 
@@ -523,8 +696,17 @@ void reshadefx::preprocessor::parse_pragma()
 
 	if (pragma == "once")
 	{
-		if (const auto it = _filecache.find(_output_location.source); it != _filecache.end())
-			it->second.clear();
+		// An empty guard macro name means the file is always skipped
+		_include_guards[location::source_name(_output_location.source)].clear();
+		return;
+	}
+
+	if (pragma.compare(0, 9, "precision") == 0)
+	{
+		// This one affects how the code is parsed, so pass it on to the parser (which validates the arguments)
+		if (++_output_location.line != keyword_location.line)
+			_output += "#line " + std::to_string(_output_location.line = keyword_location.line) + '\n';
+		_output += "#pragma " + pragma + '\n';
 		return;
 	}
 
@@ -554,20 +736,26 @@ void reshadefx::preprocessor::parse_include()
 	const std::filesystem::path filename = std::filesystem::u8path(_token.literal_as_string);
 
 	std::error_code ec;
-	std::filesystem::path filepath = std::filesystem::u8path(_output_location.source);
+	std::filesystem::path filepath = std::filesystem::u8path(location::source_name(_output_location.source));
 	filepath.replace_filename(filename);
 
-	if (!std::filesystem::exists(filepath, ec))
-		for (const auto &include_path : _include_paths)
-			if (std::filesystem::exists(filepath = include_path / filename, ec))
-				break;
+	// Remember every path that was tried before the file was found, since a file created at any of them later on would be included instead
+	for (auto include_path = _include_paths.begin(); !std::filesystem::exists(filepath, ec) && include_path != _include_paths.end(); ++include_path)
+	{
+		_missing_include_candidates.insert(filepath.u8string());
+		filepath = *include_path / filename;
+	}
+
+	// Skip files that are marked with '#pragma once' or whose include guard macro is still defined, without reading or lexing them again
+	if (const auto it = _include_guards.find(filepath.u8string()); it != _include_guards.end() && (it->second.empty() || _macros.find(it->second) != _macros.end()))
+		return;
 
 	auto it = _filecache.find(filepath.u8string());
 
 	if (it == _filecache.end())
 	{
-		std::string data;
-		if (!read_file(filepath, data))
+		std::shared_ptr<const std::string> data = read_file_cached(filepath);
+		if (data == nullptr)
 		{
 			error(keyword_location, "could not open included file '" + filepath.u8string() + "'");
 			consume_until(tokenid::end_of_line);
@@ -577,7 +765,7 @@ void reshadefx::preprocessor::parse_include()
 		it = _filecache.emplace(filepath.u8string(), std::move(data)).first;
 	}
 
-	push(it->second, filepath.u8string());
+	push(*it->second, filepath.u8string());
 }
 
 bool reshadefx::preprocessor::evaluate_expression()
@@ -777,7 +965,7 @@ bool reshadefx::preprocessor::evaluate_expression()
 						return false;
 
 					std::error_code ec;
-					std::filesystem::path filepath = std::filesystem::u8path(_output_location.source);
+					std::filesystem::path filepath = std::filesystem::u8path(location::source_name(_output_location.source));
 					filepath.replace_filename(filename);
 
 					if (!std::filesystem::exists(filepath, ec))
@@ -796,6 +984,7 @@ bool reshadefx::preprocessor::evaluate_expression()
 					if (!expect(tokenid::identifier))
 						return false;
 
+					_used_macros.insert(_token.literal_as_string);
 					const bool is_macro_defined = _macros.find(_token.literal_as_string) != _macros.end();
 
 					if (has_parentheses && !expect(tokenid::parenthesis_close))
@@ -937,7 +1126,7 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 
 	if (_token.literal_as_string == "__FILE__")
 	{
-		push('\"' + escape_string(_token.location.source) + '\"');
+		push('\"' + escape_string(location::source_name(_token.location.source)) + '\"');
 		return true;
 	}
 	if (_token.literal_as_string == "__LINE__")
@@ -946,23 +1135,37 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 		return true;
 	}
 
+	// Any identifier could be replaced if a macro with its name was defined, so all of them count as used, not just those that actually are macros
+	_used_macros.insert(_token.literal_as_string);
+
 	const auto it = _macros.find(_token.literal_as_string);
-	if (it == _macros.end() ||
-		_input_stack.top().hidden_macros.find(it->first) != _input_stack.top().hidden_macros.end())
+	if (it == _macros.end() || is_hidden_macro(it->first))
 		return false;
 
 	const auto &macro = it->second;
-	std::vector<std::string> arguments;
+
+	// Arguments may contain macros themselves, which are expanded recursively, so every nesting depth needs its own storage
+	// This is kept around after the expansion finished, so that the next one at the same depth can reuse the memory
+	if (_expansion_depth == _expansion_scratch.size())
+		_expansion_scratch.emplace_back();
+
+	expansion_scratch &scratch = _expansion_scratch[_expansion_depth];
+	scratch.argument_data.clear();
+	scratch.arguments.clear();
+	scratch.output.clear();
 
 	if (macro.is_function_like)
 	{
 		if (!accept(tokenid::parenthesis_open))
 			return false;
 
+		std::vector<size_t> &argument_offsets = scratch.argument_offsets;
+		argument_offsets.clear();
+
 		while (true)
 		{
 			int parentheses_level = 0;
-			std::string argument;
+			const size_t argument_offset = scratch.argument_data.size();
 
 			while (true)
 			{
@@ -975,31 +1178,41 @@ bool reshadefx::preprocessor::evaluate_identifier_as_macro()
 					(_token == tokenid::comma && parentheses_level == 0))
 					break;
 
-				argument += _current_token_raw_data;
+				scratch.argument_data += _current_token_raw_data;
 			}
 
-			if (!argument.empty() && argument.back() == ' ')
-				argument.pop_back();
-			if (!argument.empty() && argument.front() == ' ')
-				argument.erase(0, 1);
+			if (scratch.argument_data.size() > argument_offset && scratch.argument_data.back() == ' ')
+				scratch.argument_data.pop_back();
+			if (scratch.argument_data.size() > argument_offset && scratch.argument_data[argument_offset] == ' ')
+				scratch.argument_data.erase(argument_offset, 1);
+
+			argument_offsets.push_back(argument_offset);
 
-			arguments.push_back(argument);
+			// Terminate each argument with a special character, so that the end of it can be detected when it is expanded in 'expand_macro'
+			scratch.argument_data += static_cast<char>(macro_replacement_argument);
 
 			if (parentheses_level < 0)
 				break;
 		}
+
+		// Only reference the argument text after it is complete, since appending to it may have moved it in memory
+		for (size_t i = 0; i < argument_offsets.size(); ++i)
+			scratch.arguments.emplace_back(scratch.argument_data.data() + argument_offsets[i],
+				(i + 1 < argument_offsets.size() ? argument_offsets[i + 1] : scratch.argument_data.size()) - argument_offsets[i] - 1);
 	}
 
-	std::string input;
-	expand_macro(it->first, it->second, arguments, input);
-	push(std::move(input));
+	_expansion_depth++;
+	expand_macro(it->first, it->second, scratch.arguments, scratch.output);
+	_expansion_depth--;
+
+	push(scratch.output);
 
-	_input_stack.top().hidden_macros.insert(it->first);
+	hide_macro(it->first);
 
 	return true;
 }
 
-void reshadefx::preprocessor::expand_macro(const std::string &name, const macro &macro, const std::vector<std::string> &arguments, std::string &out)
+void reshadefx::preprocessor::expand_macro(const std::string &name, const macro &macro, const std::vector<std::string_view> &arguments, std::string &out)
 {
 	for (auto it = macro.replacement_list.begin(); it != macro.replacement_list.end(); ++it)
 	{
@@ -1029,7 +1242,8 @@ void reshadefx::preprocessor::expand_macro(const std::string &name, const macro
 			out += '"';
 			break;
 		case macro_replacement_argument:
-			push(arguments[index] + static_cast<char>(macro_replacement_argument));
+			// The argument text is followed by the special termination character in memory, so include that
+			push(std::string_view(arguments[index].data(), arguments[index].size() + 1));
 			while (!accept(tokenid::unknown))
 			{
 				consume();
@@ -6,11 +6,13 @@
 #pragma once
 
 #include <stack>
+#include <deque>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
 #include <filesystem>
+#include <string_view>
 #include "effect_lexer.hpp"
 
 namespace reshadefx
@@ -78,8 +80,39 @@ namespace reshadefx
 		/// Get a list of all included files.
 		/// </summary>
 		std::vector<std::filesystem::path> included_files() const;
+		/// <summary>
+		/// Get a list of all paths an included file was searched at but did not exist, because it was found further down the include search path (or not at all).
+		/// Creating a file at any of these paths would change which file is included, so the output then has to be considered out of date.
+		/// </summary>
+		std::vector<std::filesystem::path> missing_include_candidates() const;
+		/// <summary>
+		/// Get a list of the names of all macros that were checked or could have been expanded while pre-processing (in '#ifdef', '#if', 'defined()' or as an identifier in the source code), whether they were defined or not.
+		/// The output only depends on macro definitions with these names, so changing any other one has no effect on it.
+		/// </summary>
+		std::vector<std::string> used_macro_definitions() const;
+
+		/// <summary>
+		/// Get the number of included files that were served from the include cache shared by all preprocessor instances in this process.
+		/// </summary>
+		static size_t include_cache_hits();
+		/// <summary>
+		/// Get the number of included files that had to be read from disk because they were not in the shared include cache yet or were modified since.
+		/// </summary>
+		static size_t include_cache_misses();
+		/// <summary>
+		/// Reset the hit and miss counters of the shared include cache.
+		/// </summary>
+		static void reset_include_cache_statistics();
 
 	private:
+		enum class include_guard_state
+		{
+			none, // Input is not wrapped in an include guard
+			unknown, // No tokens were encountered yet, so input may still start with an include guard
+			open, // Input started with '#ifndef' and is inside that block
+			closed, // The '#endif' of the include guard was encountered and only space followed so far
+		};
+
 		struct if_level
 		{
 			token token;
@@ -88,21 +121,40 @@ namespace reshadefx
 		};
 		struct input_level
 		{
-			std::string name;
+			uint32_t source;
 			std::unique_ptr<lexer> lexer;
 			token next_token;
 			std::stack<if_level> if_stack;
-			std::unordered_set<std::string> hidden_macros;
-			input_level *parent;
+			size_t hidden_macros; // Index of the first entry in the list of macros that may not be expanded in this input, or zero if there are none
+			size_t hidden_macros_mark; // Number of entries in the hidden macro list when this input was pushed, everything added after belongs to it
+			std::string include_guard;
+			include_guard_state include_guard_state;
+		};
+		struct hidden_macro
+		{
+			std::string name;
+			size_t next; // Index of the next entry in the list, which are shared with the parent input levels
+		};
+		struct expansion_scratch
+		{
+			std::string argument_data; // Text of all macro arguments, each followed by a 'macro_replacement_argument' character
+			std::vector<size_t> argument_offsets;
+			std::vector<std::string_view> arguments;
+			std::string output;
 		};
 
 		void error(const location &location, const std::string &message);
 		void warning(const location &location, const std::string &message);
 
+		input_level &current_input();
 		lexer &current_lexer();
 		std::stack<if_level> &current_if_stack();
 
-		void push(std::string input, const std::string &name = std::string());
+		void push(std::string_view input, const std::string &name = std::string());
+		void pop();
+
+		bool is_hidden_macro(const std::string &name) const;
+		void hide_macro(const std::string &name);
 
 		bool peek(tokenid token) const;
 		void consume();
@@ -127,17 +179,25 @@ namespace reshadefx
 		bool evaluate_expression();
 		bool evaluate_identifier_as_macro();
 
-		void expand_macro(const std::string &name, const macro &macro, const std::vector<std::string> &arguments, std::string &out);
+		void expand_macro(const std::string &name, const macro &macro, const std::vector<std::string_view> &arguments, std::string &out);
 		void create_macro_replacement_list(macro &macro);
 
 		bool _success = true;
 		token _token;
-		std::stack<input_level> _input_stack;
+		std::vector<input_level> _input_stack; // Only the first '_input_stack_size' levels are in use, the rest is kept around so that their memory can be reused
+		size_t _input_stack_size = 0;
+		std::vector<hidden_macro> _hidden_macros = { hidden_macro() }; // The first entry is reserved, so that an index of zero can mark the end of a list
+		size_t _hidden_macros_size = 1;
+		std::deque<expansion_scratch> _expansion_scratch; // One entry for every nested macro expansion, kept around so their memory can be reused
+		size_t _expansion_depth = 0;
 		location _output_location;
 		std::string _output, _errors, _current_token_raw_data;
 		int _recursion_count = 0;
 		std::unordered_map<std::string, macro> _macros;
+		std::unordered_set<std::string> _used_macros;
 		std::vector<std::filesystem::path> _include_paths;
-		std::unordered_map<std::string, std::string> _filecache;
+		std::unordered_map<std::string, std::shared_ptr<const std::string>> _filecache;
+		std::unordered_set<std::string> _missing_include_candidates;
+		std::unordered_map<std::string, std::string> _include_guards;
 	};
 }
@@ -6,8 +6,13 @@
 #include "effect_parser.hpp"
 #include "effect_symbol_table.hpp"
 #include <assert.h>
+#include <array>
+#include <limits>
+#include <vector>
 #include <algorithm>
 #include <functional>
+#include <string_view>
+#include <unordered_map>
 
 #pragma region Import intrinsic functions
 
@@ -17,6 +22,8 @@ struct intrinsic
 {
 	intrinsic(const char *name, unsigned int id, const type &ret_type, std::initializer_list<type> arg_types) : id(id)
 	{
+		assert(arg_types.size() <= 4);
+
 		function.name = name;
 		function.return_type = ret_type;
 		function.parameter_list.reserve(arg_types.size());
@@ -28,6 +35,13 @@ struct intrinsic
 	function_info function;
 };
 
+// Parameter types of an intrinsic overload packed next to each other, so that overload resolution does not have to walk the parameter list
+struct intrinsic_signature
+{
+	const intrinsic *overload;
+	type parameter_types[4];
+};
+
 // Import intrinsic callback functions
 #define IMPLEMENT_INTRINSIC_SPIRV(name, i, code) name##i,
 enum {
@@ -92,6 +106,44 @@ static const intrinsic s_intrinsics[] = {
 #undef out_float4
 #undef sampler
 
+// Signatures of all intrinsic overloads, sorted by name and number of parameters (and in table order within those), so that the overloads a call can match are next to each other
+static const std::vector<intrinsic_signature> s_intrinsic_signatures = []() {
+	std::vector<intrinsic_signature> signatures;
+	signatures.reserve(std::size(s_intrinsics));
+	for (const intrinsic &intrinsic : s_intrinsics)
+	{
+		intrinsic_signature &signature = signatures.emplace_back();
+		signature.overload = &intrinsic;
+		for (size_t i = 0; i < intrinsic.function.parameter_list.size(); ++i)
+			signature.parameter_types[i] = intrinsic.function.parameter_list[i].type;
+	}
+
+	std::stable_sort(signatures.begin(), signatures.end(), [](const intrinsic_signature &lhs, const intrinsic_signature &rhs) {
+		const std::string_view lhs_name = lhs.overload->function.name, rhs_name = rhs.overload->function.name;
+		return lhs_name < rhs_name || (lhs_name == rhs_name && lhs.overload->function.parameter_list.size() < rhs.overload->function.parameter_list.size());
+	});
+	return signatures;
+}();
+
+// Offsets into the signature table for each intrinsic name, so that the overloads with N parameters are in the range [offsets[N], offsets[N + 1])
+static const std::unordered_map<std::string_view, std::array<uint16_t, 6>> s_intrinsic_overloads = []() {
+	assert(s_intrinsic_signatures.size() <= std::numeric_limits<uint16_t>::max());
+
+	std::unordered_map<std::string_view, std::array<uint16_t, 6>> overloads;
+	for (size_t i = 0; i < s_intrinsic_signatures.size(); ++i)
+	{
+		const function_info &function = s_intrinsic_signatures[i].overload->function;
+
+		// The first overload of a name starts all its ranges, every later one moves the end of the ranges with more parameters than it has
+		auto [it, inserted] = overloads.try_emplace(function.name);
+		if (inserted)
+			it->second.fill(static_cast<uint16_t>(i));
+		for (size_t n = function.parameter_list.size() + 1; n < it->second.size(); ++n)
+			it->second[n] = static_cast<uint16_t>(i + 1);
+	}
+	return overloads;
+}();
+
 #pragma endregion
 
 unsigned int reshadefx::type::rank(const type &src, const type &dst)
@@ -107,15 +159,17 @@ unsigned int reshadefx::type::rank(const type &src, const type &dst)
 	//  - Floating point has a higher rank than integer types
 	//  - Integer to floating point promotion has a higher rank than floating point to integer conversion
 	//  - Signed to unsigned integer conversion has a higher rank than unsigned to signed integer conversion
-	static const int ranks[4][4] = {
-		{ 5, 4, 4, 4 },
-		{ 3, 5, 2, 4 },
-		{ 3, 1, 5, 4 },
-		{ 3, 3, 3, 6 }
+	//  - Conversion between minimum and full precision floating point has a higher rank than any other conversion
+	static const int ranks[5][5] = {
+		{ 5, 4, 4, 4, 4 },
+		{ 3, 5, 2, 4, 4 },
+		{ 3, 1, 5, 4, 4 },
+		{ 3, 3, 3, 6, 5 },
+		{ 3, 3, 3, 5, 6 }
 	};
 
-	assert(src.base > 0 && src.base <= 4);
-	assert(dst.base > 0 && dst.base <= 4);
+	assert(src.base > 0 && src.base <= 5);
+	assert(dst.base > 0 && dst.base <= 5);
 
 	const int rank = ranks[src.base - 1][dst.base - 1] << 2;
 
@@ -150,22 +204,21 @@ void reshadefx::symbol_table::leave_scope()
 {
 	assert(_current_scope.level > 0);
 
-	for (auto &symbol : _symbol_stack)
+	// Local symbols are logged in insertion order, so all symbols of this scope (and any nested ones) are at the end of the log
+	while (!_scope_log.empty() && _scope_log.back().first >= _current_scope.level)
 	{
-		std::vector<scoped_symbol> &scope_list = symbol.second;
+		std::vector<scoped_symbol> &scope_list = *_scope_log.back().second;
 
-		for (auto scope_it = scope_list.begin(); scope_it != scope_list.end();)
-		{
-			if (scope_it->scope.level > scope_it->scope.namespace_level &&
-				scope_it->scope.level >= _current_scope.level)
-			{
-				scope_it = scope_list.erase(scope_it);
-			}
-			else
-			{
-				++scope_it;
-			}
-		}
+		// Each log entry corresponds to exactly one symbol in the list of symbols with that name
+		const auto scope_it = std::find_if(scope_list.rbegin(), scope_list.rend(),
+			[this](const scoped_symbol &symbol) {
+				return symbol.scope.level > symbol.scope.namespace_level && symbol.scope.level >= _current_scope.level;
+			});
+
+		assert(scope_it != scope_list.rend());
+		scope_list.erase(std::next(scope_it).base());
+
+		_scope_log.pop_back();
 	}
 
 	_current_scope.level--;
@@ -219,7 +272,12 @@ bool reshadefx::symbol_table::insert_symbol(const std::string &name, const symbo
 	else
 	{
 		// This is a local symbol so it's sufficient to update the symbol stack with just the current scope
-		insert_sorted(_symbol_stack[name], scoped_symbol { symbol, _current_scope });
+		auto &scope_list = _symbol_stack[name];
+		insert_sorted(scope_list, scoped_symbol { symbol, _current_scope });
+
+		// Remember symbols that need to be removed again when leaving the current scope
+		if (_current_scope.level > _current_scope.namespace_level)
+			_scope_log.emplace_back(_current_scope.level, &scope_list);
 	}
 
 	return true;
@@ -367,15 +425,36 @@ bool reshadefx::symbol_table::resolve_function_call(const std::string &name, con
 	}
 
 	// Try matching against intrinsic functions if no matching user-defined function was found up to this point
-	if (num_overloads == 0)
+	if (const auto overloads_it = num_overloads == 0 && arguments.size() <= 4 ? s_intrinsic_overloads.find(name) : s_intrinsic_overloads.end();
+		overloads_it != s_intrinsic_overloads.end())
 	{
-		for (const intrinsic &intrinsic : s_intrinsics)
+		const size_t num_arguments = arguments.size();
+
+		// The ranks of the best match so far are kept around, instead of computing them again for every comparison
+		unsigned int result_ranks[4] = {};
+
+		// Only the overloads with a matching name and number of parameters are considered
+		const intrinsic_signature *const overloads_begin = s_intrinsic_signatures.data() + overloads_it->second[num_arguments];
+		const intrinsic_signature *const overloads_end = s_intrinsic_signatures.data() + overloads_it->second[num_arguments + 1];
+
+		for (const intrinsic_signature *signature = overloads_begin; signature != overloads_end; ++signature)
 		{
-			if (intrinsic.function.name != name || intrinsic.function.parameter_list.size() != arguments.size())
+			const intrinsic &intrinsic = *signature->overload;
+
+			unsigned int ranks[4] = {};
+			bool viable = true;
+			for (size_t i = 0; i < num_arguments && viable; ++i)
+				viable = (ranks[i] = type::rank(arguments[i].type, signature->parameter_types[i])) != 0;
+
+			if (!viable)
 				continue;
 
+			std::sort(ranks, ranks + num_arguments, std::greater<unsigned int>());
+
 			// A new possibly-matching intrinsic function was found, compare it against the current result
-			const int comparison = compare_functions(arguments, &intrinsic.function, result);
+			const int comparison = result == nullptr ? -1 :
+				std::lexicographical_compare(result_ranks, result_ranks + num_arguments, ranks, ranks + num_arguments) ? -1 :
+				std::lexicographical_compare(ranks, ranks + num_arguments, result_ranks, result_ranks + num_arguments) ? 1 : 0;
 
 			if (comparison < 0) // The new function is a better match
 			{
@@ -385,6 +464,7 @@ bool reshadefx::symbol_table::resolve_function_call(const std::string &name, con
 				out_data.function = &intrinsic.function;
 				result = out_data.function;
 				num_overloads = 1;
+				std::copy(ranks, ranks + num_arguments, result_ranks);
 			}
 			else if (comparison == 0 && overload_namespace == 0) // Both functions are equally viable, so the call is ambiguous (intrinsics are always in the global namespace)
 			{
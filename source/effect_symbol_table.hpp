@@ -98,5 +98,7 @@ namespace reshadefx
 		scope _current_scope;
 		std::unordered_map<std::string, // Lookup table from name to matching symbols
 			std::vector<scoped_symbol>> _symbol_stack;
+		std::vector<std::pair<unsigned int, // Log of local symbols in the order they were inserted, so that leaving a scope only has to touch the symbols added in it
+			std::vector<scoped_symbol> *>> _scope_log;
 	};
 }
@@ -1491,6 +1491,13 @@ void imgui_code_editor::colorize()
 		case reshadefx::tokenid::float2x2:
 		case reshadefx::tokenid::float3x3:
 		case reshadefx::tokenid::float4x4:
+		case reshadefx::tokenid::min16float:
+		case reshadefx::tokenid::min16float2:
+		case reshadefx::tokenid::min16float3:
+		case reshadefx::tokenid::min16float4:
+		case reshadefx::tokenid::min16float2x2:
+		case reshadefx::tokenid::min16float3x3:
+		case reshadefx::tokenid::min16float4x4:
 		case reshadefx::tokenid::vector:
 		case reshadefx::tokenid::matrix:
 		case reshadefx::tokenid::string_:
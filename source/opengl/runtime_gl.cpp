@@ -594,15 +594,15 @@ bool reshade::opengl::runtime_gl::compile_effect(effect_data &effect)
 		glSpecializeShader(shader_id, entry_point.first.c_str(), GLuint(spec_constants.size()), spec_constants.data(), spec_constant_values.data());
 #else
 		std::string defines = effect.preamble;
-		defines += "#define ENTRY_POINT_" + entry_point.name + " 1\n";
 		if (!entry_point.is_pixel_shader) // OpenGL does not allow using 'discard' in the vertex shader profile
 			defines += "#define discard\n"
 				"#define dFdx(x) x\n" // 'dFdx', 'dFdx' and 'fwidth' too are only available in fragment shaders
 				"#define dFdy(y) y\n"
 				"#define fwidth(p) p\n";
 
-		GLsizei lengths[] = { static_cast<GLsizei>(defines.size()), static_cast<GLsizei>(effect.module.hlsl.size()) };
-		const GLchar *sources[] = { defines.c_str(), effect.module.hlsl.c_str() };
+		// Only compile the code this entry point actually uses, instead of the code of the entire effect every time
+		GLsizei lengths[] = { static_cast<GLsizei>(defines.size()), static_cast<GLsizei>(entry_point.code.size()) };
+		const GLchar *sources[] = { defines.c_str(), entry_point.code.c_str() };
 		glShaderSource(shader_id, 2, sources, lengths);
 		glCompileShader(shader_id);
 #endif
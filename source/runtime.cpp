@@ -9,6 +9,7 @@
 #include "runtime_objects.hpp"
 #include "effect_parser.hpp"
 #include "effect_codegen.hpp"
+#include "effect_module.hpp"
 #include "effect_preprocessor.hpp"
 #include "input.hpp"
 #include "ini_file.hpp"
@@ -95,6 +96,223 @@ static std::vector<std::filesystem::path> find_files(const std::vector<std::file
 	return files;
 }
 
+// 64-bit FNV-1a, which is stable across runs and builds (unlike 'std::hash'), so can be used to name files in the effect cache
+static uint64_t hash_data(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+	for (size_t i = 0; i < size; ++i)
+		hash = (hash ^ static_cast<const uint8_t *>(data)[i]) * 1099511628211ull;
+	return hash;
+}
+static uint64_t hash_data(const std::string &data, uint64_t hash = 14695981039346656037ull)
+{
+	return hash_data(data.data(), data.size(), hash);
+}
+
+// Layout of an entry in the effect cache, which is followed by the compiled module in the format of 'reshadefx::write_module'
+// Increment the version whenever the layout or the output of the compiler changes, so that old cache entries are ignored
+static const uint32_t effect_cache_magic = 0x43465852; // "RXFC"
+static const uint32_t effect_cache_version = 3;
+
+class effect_cache_writer
+{
+public:
+	void write(uint32_t value) { _data.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+	void write(uint64_t value) { _data.append(reinterpret_cast<const char *>(&value), sizeof(value)); }
+	void write(const std::string &value) { write(static_cast<uint32_t>(value.size())); _data += value; }
+
+	const std::string &data() const { return _data; }
+
+private:
+	std::string _data;
+};
+
+class effect_cache_reader
+{
+public:
+	explicit effect_cache_reader(const std::vector<char> &data) : _cur(data.data()), _end(data.data() + data.size()) {}
+
+	// Reading past the end of the data does not crash, but marks the whole entry as invalid, so that truncated files are simply ignored
+	bool valid() const { return _valid; }
+
+	void read(uint32_t &value) { read_raw(&value, sizeof(value)); }
+	void read(uint64_t &value) { read_raw(&value, sizeof(value)); }
+	void read(std::string &value) { value = read_view(); }
+	std::string_view read_view()
+	{
+		const uint32_t size = read_count();
+		if (!_valid)
+			return {};
+		const std::string_view value(_cur, size);
+		_cur += size;
+		return value;
+	}
+	void read_raw(void *data, size_t size)
+	{
+		if (!_valid || size > static_cast<size_t>(_end - _cur))
+			return void(_valid = false);
+		std::memcpy(data, _cur, size);
+		_cur += size;
+	}
+	uint32_t read_value()
+	{
+		uint32_t value = 0;
+		read(value);
+		return value;
+	}
+	uint64_t read_value64()
+	{
+		uint64_t value = 0;
+		read(value);
+		return value;
+	}
+	uint32_t read_count()
+	{
+		uint32_t count = 0;
+		read(count);
+		// Counts can never be larger than the remaining data, so catch corrupted files before trying to allocate huge amounts of memory
+		if (count > static_cast<size_t>(_end - _cur))
+			_valid = false;
+		return _valid ? count : 0;
+	}
+
+private:
+	const char *_cur, *_end;
+	bool _valid = true;
+};
+
+// Files are identified by their size and last modification time, so that checking an entry does not have to read and hash all of them again
+static bool get_file_stamp(const std::filesystem::path &path, uint64_t &size, uint64_t &time)
+{
+	std::error_code ec;
+	size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+	if (ec)
+		return false;
+	time = static_cast<uint64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+	return !ec;
+}
+
+static bool load_effect_cache(const std::filesystem::path &cache_path, const std::string &cache_key, const std::unordered_map<std::string, std::string> &macros, reshade::effect_data &effect)
+{
+	std::vector<char> data;
+	if (FILE *file; _wfopen_s(&file, cache_path.c_str(), L"rb") == 0)
+	{
+		std::error_code ec;
+		data.resize(static_cast<size_t>(std::filesystem::file_size(cache_path, ec)));
+		data.resize(fread(data.data(), 1, data.size(), file));
+		fclose(file);
+	}
+
+	effect_cache_reader reader(data);
+
+	if (reader.read_value() != effect_cache_magic || reader.read_value() != effect_cache_version)
+		return false;
+
+	// The file name is only a hash of the key, so make sure this entry really belongs to it
+	if (reader.read_view() != cache_key || !reader.valid())
+		return false;
+
+	// The entry is only valid if none of the files the effect was compiled from changed since
+	for (uint32_t i = 0, count = reader.read_count(); i < count; ++i)
+	{
+		const std::filesystem::path file_path = std::filesystem::u8path(reader.read_view());
+		const uint64_t file_size = reader.read_value64();
+		const uint64_t file_time = reader.read_value64();
+
+		if (uint64_t size, time; !reader.valid() || !get_file_stamp(file_path, size, time) || size != file_size || time != file_time)
+			return false;
+	}
+
+	// Nor may a file have been created that is found before one of them when searching for an included file
+	for (uint32_t i = 0, count = reader.read_count(); i < count; ++i)
+	{
+		std::error_code ec;
+		if (!reader.valid() || std::filesystem::exists(std::filesystem::u8path(reader.read_view()), ec))
+			return false;
+	}
+
+	// Neither may any of the macros the effect used have been defined, removed or changed since (all other macros are irrelevant for it)
+	std::string name, value;
+	for (uint32_t i = 0, count = reader.read_count(); i < count; ++i)
+	{
+		reader.read(name);
+		const bool is_defined = reader.read_value() != 0;
+		reader.read(value);
+
+		if (!reader.valid())
+			return false;
+
+		if (const auto it = macros.find(name); is_defined ? it == macros.end() || it->second != value : it != macros.end())
+			return false;
+	}
+
+	reshade::effect_data cached_effect;
+	reader.read(cached_effect.errors);
+
+	// The module is read straight from the file data, without copying it first
+	if (!reshadefx::read_module(reader.read_view(), cached_effect.module) || !reader.valid())
+		return false;
+
+	effect.errors = std::move(cached_effect.errors);
+	effect.module = std::move(cached_effect.module);
+	return true;
+}
+static void save_effect_cache(const std::filesystem::path &cache_path, const std::string &cache_key, const reshade::effect_data &effect, const std::vector<std::filesystem::path> &dependencies, const std::vector<std::filesystem::path> &missing_include_candidates, const std::vector<std::string> &used_macros, const std::unordered_map<std::string, std::string> &macros)
+{
+	effect_cache_writer writer;
+	writer.write(effect_cache_magic);
+	writer.write(effect_cache_version);
+	writer.write(cache_key);
+
+	writer.write(static_cast<uint32_t>(dependencies.size()));
+	for (const std::filesystem::path &file_path : dependencies)
+	{
+		uint64_t file_size, file_time;
+		if (!get_file_stamp(file_path, file_size, file_time))
+			return;
+
+		writer.write(file_path.u8string());
+		writer.write(file_size);
+		writer.write(file_time);
+	}
+
+	writer.write(static_cast<uint32_t>(missing_include_candidates.size()));
+	for (const std::filesystem::path &file_path : missing_include_candidates)
+		writer.write(file_path.u8string());
+
+	writer.write(static_cast<uint32_t>(used_macros.size()));
+	for (const std::string &name : used_macros)
+	{
+		const auto it = macros.find(name);
+		writer.write(name);
+		writer.write(static_cast<uint32_t>(it != macros.end()));
+		writer.write(it != macros.end() ? it->second : std::string());
+	}
+
+	std::string module_data;
+	reshadefx::write_module(effect.module, module_data);
+
+	writer.write(effect.errors);
+	writer.write(module_data);
+
+	std::error_code ec;
+	std::filesystem::create_directories(cache_path.parent_path(), ec);
+
+	// Write to a temporary file first and rename it afterwards, so that a partially written entry is never picked up
+	std::filesystem::path temp_path = cache_path;
+	temp_path += L".tmp";
+
+	FILE *file = nullptr;
+	if (_wfopen_s(&file, temp_path.c_str(), L"wb") != 0)
+		return;
+	const bool success = fwrite(writer.data().data(), 1, writer.data().size(), file) == writer.data().size();
+	fclose(file);
+
+	if (success)
+		std::filesystem::rename(temp_path, cache_path, ec);
+	else
+		std::filesystem::remove(temp_path, ec);
+}
+
 reshade::runtime::runtime() :
 	_start_time(std::chrono::high_resolution_clock::now()),
 	_last_present_time(std::chrono::high_resolution_clock::now()),
@@ -126,6 +344,9 @@ reshade::runtime::runtime() :
 		// If neither exist create a "ReShade.ini" in the ReShade DLL directory
 		_configuration_path = g_reshade_dll_path.parent_path() / "ReShade.ini";
 
+	// Compiled effects are cached in a directory next to the configuration file
+	_effect_cache_path = _configuration_path.parent_path() / "ReShadeEffectCache";
+
 	_needs_update = check_for_update(_latest_version);
 
 #if RESHADE_GUI
@@ -308,18 +529,21 @@ void reshade::runtime::load_effect(const std::filesystem::path &path, size_t &ou
 				pp.add_include_path(include_path);
 		}
 
-		pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
-		pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", _performance_mode ? "1" : "0");
-		pp.add_macro_definition("__VENDOR__", std::to_string(_vendor_id));
-		pp.add_macro_definition("__DEVICE__", std::to_string(_device_id));
-		pp.add_macro_definition("__RENDERER__", std::to_string(_renderer_id));
+		// Collect all macro definitions first, so that the effect cache can compare them with the ones a cached effect depends on
+		// The preprocessor ignores later definitions of the same macro, which is matched by only adding the first one with each name here
+		std::unordered_map<std::string, std::string> macros;
+		macros.emplace("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
+		macros.emplace("__RESHADE_PERFORMANCE_MODE__", _performance_mode ? "1" : "0");
+		macros.emplace("__VENDOR__", std::to_string(_vendor_id));
+		macros.emplace("__DEVICE__", std::to_string(_device_id));
+		macros.emplace("__RENDERER__", std::to_string(_renderer_id));
 		// Truncate hash to 32-bit, since lexer currently only supports 32-bit numbers anyway
-		pp.add_macro_definition("__APPLICATION__", std::to_string(std::hash<std::string>()(g_target_executable_path.stem().u8string()) & 0xFFFFFFFF));
-		pp.add_macro_definition("BUFFER_WIDTH", std::to_string(_width));
-		pp.add_macro_definition("BUFFER_HEIGHT", std::to_string(_height));
-		pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
-		pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
-		pp.add_macro_definition("BUFFER_COLOR_DEPTH", std::to_string(_backbuffer_color_depth));
+		macros.emplace("__APPLICATION__", std::to_string(std::hash<std::string>()(g_target_executable_path.stem().u8string()) & 0xFFFFFFFF));
+		macros.emplace("BUFFER_WIDTH", std::to_string(_width));
+		macros.emplace("BUFFER_HEIGHT", std::to_string(_height));
+		macros.emplace("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+		macros.emplace("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+		macros.emplace("BUFFER_COLOR_DEPTH", std::to_string(_backbuffer_color_depth));
 
 		std::vector<std::string> preprocessor_definitions = _global_preprocessor_definitions;
 		preprocessor_definitions.insert(preprocessor_definitions.end(), _preset_preprocessor_definitions.begin(), _preset_preprocessor_definitions.end());
@@ -331,53 +555,85 @@ void reshade::runtime::load_effect(const std::filesystem::path &path, size_t &ou
 
 			const size_t equals_index = definition.find('=');
 			if (equals_index != std::string::npos)
-				pp.add_macro_definition(
+				macros.emplace(
 					definition.substr(0, equals_index),
 					definition.substr(equals_index + 1));
 			else
-				pp.add_macro_definition(definition);
+				macros.emplace(definition, "1");
 		}
 
-		if (!pp.append_file(path))
+		for (const auto &[name, value] : macros)
+			pp.add_macro_definition(name, value);
+
+		// Everything else that influences the compiled result goes into the key of the cache entry
+		// The source and included files and the values of the macros the effect uses are only known after pre-processing, so they are checked when loading the entry instead
+		std::string cache_key = path.u8string() + '\n' + std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION) + '\n' + std::to_string(_renderer_id) + '\n' + (_performance_mode ? "performance\n" : "\n") + (_no_effect_optimization ? "unoptimized\n" : "\n");
+		for (const std::filesystem::path &include_path : _effect_search_paths)
+			cache_key += absolute_path(include_path).u8string() + '\n';
+
+		char cache_file_name[32];
+		sprintf_s(cache_file_name, "%016llx.bin", static_cast<unsigned long long>(hash_data(cache_key)));
+		const std::filesystem::path cache_path = _effect_cache_path / cache_file_name;
+
+		if (load_effect_cache(cache_path, cache_key, macros, effect))
 		{
-			LOG(ERROR) << "Failed to load " << path << ":\n" << pp.errors();
-			effect.compile_sucess = false;
+			_effect_cache_hits++;
 		}
-
-		unsigned shader_model;
-		if (_renderer_id == 0x9000)     // D3D9
-			shader_model = 30;
-		else if (_renderer_id < 0xa100) // D3D10
-			shader_model = 40;
-		else if (_renderer_id < 0xb000) // D3D11
-			shader_model = 41;
-		else if (_renderer_id < 0xc000) // D3D12
-			shader_model = 50;
 		else
-			shader_model = 60;
+		{
+			if (!pp.append_file(path))
+			{
+				LOG(ERROR) << "Failed to load " << path << ":\n" << pp.errors();
+				effect.compile_sucess = false;
+			}
 
-		std::unique_ptr<reshadefx::codegen> codegen;
-		if ((_renderer_id & 0xF0000) == 0)
-			codegen.reset(reshadefx::create_codegen_hlsl(shader_model, true, _performance_mode));
-		else if (_renderer_id < 0x20000)
-			codegen.reset(reshadefx::create_codegen_glsl(true, _performance_mode));
-		else // Vulkan uses SPIR-V input
-			codegen.reset(reshadefx::create_codegen_spirv(true, true, _performance_mode));
+			unsigned shader_model;
+			if (_renderer_id == 0x9000)     // D3D9
+				shader_model = 30;
+			else if (_renderer_id < 0xa100) // D3D10
+				shader_model = 40;
+			else if (_renderer_id < 0xb000) // D3D11
+				shader_model = 41;
+			else if (_renderer_id < 0xc000) // D3D12
+				shader_model = 50;
+			else
+				shader_model = 60;
 
-		reshadefx::parser parser;
+			std::unique_ptr<reshadefx::codegen> backend;
+			if ((_renderer_id & 0xF0000) == 0)
+				backend.reset(reshadefx::create_codegen_hlsl(shader_model, true, _performance_mode));
+			else if (_renderer_id < 0x20000)
+				backend.reset(reshadefx::create_codegen_glsl(true, _performance_mode));
+			else // Vulkan uses SPIR-V input
+				backend.reset(reshadefx::create_codegen_spirv(true, true, _performance_mode));
 
-		// Compile the pre-processed source code (try the compile even if the preprocessor step failed to get additional error information)
-		if (!parser.parse(std::move(pp.output()), codegen.get()))
-		{
-			LOG(ERROR) << "Failed to compile " << path << ":\n" << pp.errors() << parser.errors();
-			effect.compile_sucess = false;
-		}
+			// Optimize the code before it is passed on to the back-end (and unroll loops with a known trip count that grow to no more than 1024 instructions)
+			// This can be turned off in the configuration to rule out the optimizer when looking into a problem with an effect, similar to the '-Od' option of fxc
+			const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_ir({ backend.get() }, !_no_effect_optimization, 1024));
+
+			reshadefx::parser parser;
+
+			// Compile the pre-processed source code (try the compile even if the preprocessor step failed to get additional error information)
+			if (!parser.parse(std::move(pp.output()), codegen.get()))
+			{
+				LOG(ERROR) << "Failed to compile " << path << ":\n" << pp.errors() << parser.errors();
+				effect.compile_sucess = false;
+			}
 
-		// Append preprocessor and parser errors to the error list
-		effect.errors = std::move(pp.errors()) + std::move(parser.errors());
+			// Append preprocessor and parser errors to the error list
+			effect.errors = std::move(pp.errors()) + std::move(parser.errors());
 
-		// Write result to effect module
-		codegen->write_result(effect.module);
+			// Write result to effect module
+			codegen->write_result(effect.module);
+
+			// Only store successfully compiled effects, so that errors are always reported with the current state of the files
+			if (effect.compile_sucess)
+			{
+				std::vector<std::filesystem::path> dependencies = pp.included_files();
+				dependencies.insert(dependencies.begin(), path);
+				save_effect_cache(cache_path, cache_key, effect, dependencies, pp.missing_include_candidates(), pp.used_macro_definitions(), macros);
+			}
+		}
 	}
 
 	// Fill all specialization constants with values from the current preset
@@ -567,6 +823,10 @@ void reshade::runtime::load_effects()
 	if (_reload_total_effects == 0)
 		return; // No effect files found, so nothing more to do
 
+	reshadefx::preprocessor::reset_include_cache_statistics();
+	_effect_cache_hits = 0;
+	_reload_start_time = std::chrono::high_resolution_clock::now();
+
 	// Now that we have a list of files, load them in parallel
 	// Split workload into batches instead of launching a thread for every file to avoid launch overhead and stutters due to too many threads being in flight
 	const size_t num_splits = std::min<size_t>(effect_files.size(), std::max<size_t>(std::thread::hardware_concurrency(), 2u) - 1);
@@ -691,6 +951,10 @@ void reshade::runtime::update_and_render_effects()
 
 	if (_reload_remaining_effects == 0)
 	{
+		LOG(INFO) << "Finished loading effects in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - _reload_start_time).count() << " ms, with "
+			<< _effect_cache_hits << " of " << _reload_total_effects << " effects loaded from the effect cache (the rest had to be compiled), "
+			<< reshadefx::preprocessor::include_cache_hits() << " include cache hits and " << reshadefx::preprocessor::include_cache_misses() << " misses.";
+
 		// Finished loading effects, so apply preset to figure out which ones need compiling
 		load_current_preset();
 
@@ -982,6 +1246,7 @@ void reshade::runtime::load_config()
 	config.get("GENERAL", "ScreenshotIncludePreset", _screenshot_include_preset);
 	config.get("GENERAL", "ScreenshotSaveBefore", _screenshot_save_before);
 	config.get("GENERAL", "NoReloadOnInit", _no_reload_on_init);
+	config.get("GENERAL", "NoEffectOptimization", _no_effect_optimization);
 
 	if (current_preset_path.empty())
 	{
@@ -1024,6 +1289,7 @@ void reshade::runtime::save_config() const
 	config.set("GENERAL", "ScreenshotIncludePreset", _screenshot_include_preset);
 	config.set("GENERAL", "ScreenshotSaveBefore", _screenshot_save_before);
 	config.set("GENERAL", "NoReloadOnInit", _no_reload_on_init);
+	config.set("GENERAL", "NoEffectOptimization", _no_effect_optimization);
 
 	for (const auto &callback : _save_config_callables)
 		callback(config);
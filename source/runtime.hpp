@@ -273,6 +273,7 @@ namespace reshade
 		int _screenshot_format = 1;
 		std::filesystem::path _screenshot_path;
 		std::filesystem::path _configuration_path;
+		std::filesystem::path _effect_cache_path;
 		std::filesystem::path _last_screenshot_file;
 		bool _screenshot_save_success = false;
 		bool _screenshot_include_preset = false;
@@ -288,6 +289,7 @@ namespace reshade
 		bool _textures_loaded = false;
 		bool _performance_mode = false;
 		bool _no_reload_on_init = false;
+		bool _no_effect_optimization = false;
 		bool _last_reload_successful = true;
 		bool _should_save_screenshot = false;
 		bool _is_in_between_presets_transition = false;
@@ -295,6 +297,8 @@ namespace reshade
 		size_t _reload_total_effects = 1;
 		std::vector<size_t> _reload_compile_queue;
 		std::atomic<size_t> _reload_remaining_effects = 0;
+		std::atomic<size_t> _effect_cache_hits = 0;
+		std::chrono::high_resolution_clock::time_point _reload_start_time;
 		std::vector<effect_data> _loaded_effects;
 		std::vector<std::thread> _worker_threads;
 
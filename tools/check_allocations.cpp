@@ -0,0 +1,195 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Counts the heap allocations made while compiling effects and checks that nothing created by the parser is needed after it was destroyed.
+// Every effect is compiled the way the runtime does it, which destroys the parser before the code generator writes its result, and again with the parser kept alive until after that. For each effect this checks that:
+//   - both ways produce the same module
+//   - all memory allocated while compiling is freed again once the parser, code generator and module are gone
+// Build it with AddressSanitizer enabled to also catch reads from memory that was freed together with the parser.
+//
+// Build it like fxc (it needs the ReShadeFX library), then run:
+//   check_allocations [-I <path>] <filename> ...
+
+#include "effect_parser.hpp"
+#include "effect_codegen.hpp"
+#include "effect_module.hpp"
+#include "effect_preprocessor.hpp"
+#include <new>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+// Replace all the (not over-aligned) allocation functions, so that every allocation is counted and no block is freed by a different allocator than the one that allocated it
+static size_t s_num_allocations = 0;
+static size_t s_num_live_allocations = 0;
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	void *const block = std::malloc(size != 0 ? size : 1);
+	if (block == nullptr)
+		return nullptr;
+	s_num_allocations++;
+	s_num_live_allocations++;
+	return block;
+}
+void *operator new(size_t size)
+{
+	if (void *const block = operator new(size, std::nothrow))
+		return block;
+	throw std::bad_alloc();
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *block) noexcept
+{
+	if (block == nullptr)
+		return;
+	s_num_live_allocations--;
+	std::free(block);
+}
+void operator delete(void *block, size_t) noexcept
+{
+	operator delete(block);
+}
+void operator delete(void *block, const std::nothrow_t &) noexcept
+{
+	operator delete(block);
+}
+void operator delete[](void *block) noexcept
+{
+	operator delete(block);
+}
+void operator delete[](void *block, size_t) noexcept
+{
+	operator delete(block);
+}
+void operator delete[](void *block, const std::nothrow_t &) noexcept
+{
+	operator delete(block);
+}
+
+struct allocation_counts
+{
+	size_t parse = 0;
+	size_t write_result = 0;
+};
+
+static bool compile(const std::string &source, bool destroy_parser_first, reshadefx::module &module, allocation_counts &counts, std::string &errors)
+{
+	const std::unique_ptr<reshadefx::codegen> backend(reshadefx::create_codegen_hlsl(50, true, false));
+	const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_ir({ backend.get() }, true, 1024));
+
+	auto parser = std::make_unique<reshadefx::parser>();
+
+	size_t start = s_num_allocations;
+	const bool success = parser->parse(source, codegen.get());
+	counts.parse = s_num_allocations - start;
+	errors = parser->errors();
+
+	if (destroy_parser_first)
+		parser.reset();
+
+	start = s_num_allocations;
+	if (success)
+		codegen->write_result(module);
+	counts.write_result = s_num_allocations - start;
+
+	return success;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::filesystem::path> files, include_paths;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (0 == strcmp(argv[i], "-I") && i + 1 < argc)
+			include_paths.push_back(argv[++i]);
+		else
+			files.push_back(argv[i]);
+	}
+
+	if (files.empty())
+	{
+		printf("usage: %s [-I <path>] <filename> ...\n", argv[0]);
+		return 1;
+	}
+
+	unsigned int failures = 0;
+
+	for (const std::filesystem::path &path : files)
+	{
+		reshadefx::preprocessor pp;
+		for (const std::filesystem::path &include_path : include_paths)
+			pp.add_include_path(include_path);
+		pp.add_macro_definition("BUFFER_WIDTH", "800");
+		pp.add_macro_definition("BUFFER_HEIGHT", "600");
+		pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+		pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+
+		if (!pp.append_file(path))
+		{
+			printf("%s: failed to preprocess:\n%s\n", path.u8string().c_str(), pp.errors().c_str());
+			failures++;
+			continue;
+		}
+
+		std::string errors, reference_data;
+		allocation_counts counts;
+
+		// Compile once up front, so that the source file names the compiler keeps around for good are already there when counting
+		{
+			reshadefx::module module;
+			if (!compile(pp.output(), false, module, counts, errors))
+			{
+				printf("%s: failed to compile:\n%s\n", path.u8string().c_str(), errors.c_str());
+				failures++;
+				continue;
+			}
+			reshadefx::write_module(module, reference_data);
+		}
+
+		const size_t num_live_allocations = s_num_live_allocations;
+
+		bool same_module = false;
+		{
+			std::string data, warnings;
+			reshadefx::module module;
+			compile(pp.output(), true, module, counts, warnings);
+			reshadefx::write_module(module, data);
+			same_module = data == reference_data;
+		}
+
+		const char *error = nullptr;
+		if (!same_module)
+			error = "destroying the parser before writing the result gives a different module";
+		else if (s_num_live_allocations != num_live_allocations)
+			error = "not all memory allocated while compiling was freed";
+
+		if (error != nullptr)
+		{
+			printf("%s: %s\n", path.u8string().c_str(), error);
+			failures++;
+			continue;
+		}
+
+		printf("%s: %zu allocations to parse, %zu allocations to write the result\n", path.u8string().c_str(), counts.parse, counts.write_result);
+	}
+
+	if (failures != 0)
+		printf("%u checks failed\n", failures);
+
+	return failures != 0 ? 1 : 0;
+}
@@ -0,0 +1,298 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Checks that the lexer recognizes exactly the keywords and preprocessor directives it should.
+// The tables below are the 'std::unordered_map' tables the lexer used before it switched to compile-time hash tables (plus the keywords added since), and every entry in them is compared against what the lexer returns.
+// Variations of every keyword (changed case, a prefix, a suffix or a character less) and a large number of generated identifiers are checked too, since those must not be mistaken for keywords.
+//
+// Build it like fxc (it needs the ReShadeFX library), then run:
+//   check_keywords
+
+#include "effect_lexer.hpp"
+#include <string>
+#include <cstdio>
+#include <cctype>
+#include <unordered_map>
+
+using namespace reshadefx;
+
+static const std::unordered_map<std::string, tokenid> keyword_lookup = {
+	{ "asm", tokenid::reserved },
+	{ "asm_fragment", tokenid::reserved },
+	{ "auto", tokenid::reserved },
+	{ "bool", tokenid::bool_ },
+	{ "bool2", tokenid::bool2 },
+	{ "bool2x2", tokenid::bool2x2 },
+	{ "bool3", tokenid::bool3 },
+	{ "bool3x3", tokenid::bool3x3 },
+	{ "bool4", tokenid::bool4 },
+	{ "bool4x4", tokenid::bool4x4 },
+	{ "break", tokenid::break_ },
+	{ "case", tokenid::case_ },
+	{ "cast", tokenid::reserved },
+	{ "catch", tokenid::reserved },
+	{ "centroid", tokenid::reserved },
+	{ "char", tokenid::reserved },
+	{ "class", tokenid::reserved },
+	{ "column_major", tokenid::reserved },
+	{ "compile", tokenid::reserved },
+	{ "const", tokenid::const_ },
+	{ "const_cast", tokenid::reserved },
+	{ "continue", tokenid::continue_ },
+	{ "default", tokenid::default_ },
+	{ "delete", tokenid::reserved },
+	{ "discard", tokenid::discard_ },
+	{ "do", tokenid::do_ },
+	{ "double", tokenid::reserved },
+	{ "dword", tokenid::uint_ },
+	{ "dword2", tokenid::uint2 },
+	{ "dword2x2", tokenid::uint2x2 },
+	{ "dword3x3", tokenid::uint3x3 },
+	{ "dword4", tokenid::uint4 },
+	{ "dword4x4", tokenid::uint4x4 },
+	{ "dynamic_cast", tokenid::reserved },
+	{ "else", tokenid::else_ },
+	{ "enum", tokenid::reserved },
+	{ "explicit", tokenid::reserved },
+	{ "extern", tokenid::extern_ },
+	{ "external", tokenid::reserved },
+	{ "false", tokenid::false_literal },
+	{ "FALSE", tokenid::false_literal },
+	{ "float", tokenid::float_ },
+	{ "float2", tokenid::float2 },
+	{ "float2x2", tokenid::float2x2 },
+	{ "float3", tokenid::float3 },
+	{ "float3x3", tokenid::float3x3 },
+	{ "float4", tokenid::float4 },
+	{ "float4x4", tokenid::float4x4 },
+	{ "for", tokenid::for_ },
+	{ "foreach", tokenid::reserved },
+	{ "friend", tokenid::reserved },
+	{ "globallycoherent", tokenid::reserved },
+	{ "goto", tokenid::reserved },
+	{ "groupshared", tokenid::reserved },
+	{ "half", tokenid::min16float },
+	{ "half2", tokenid::min16float2 },
+	{ "half2x2", tokenid::min16float2x2 },
+	{ "half3", tokenid::min16float3 },
+	{ "half3x3", tokenid::min16float3x3 },
+	{ "half4", tokenid::min16float4 },
+	{ "half4x4", tokenid::min16float4x4 },
+	{ "if", tokenid::if_ },
+	{ "in", tokenid::in },
+	{ "inline", tokenid::reserved },
+	{ "inout", tokenid::inout },
+	{ "int", tokenid::int_ },
+	{ "int2", tokenid::int2 },
+	{ "int2x2", tokenid::int2x2 },
+	{ "int3", tokenid::int3 },
+	{ "int3x3", tokenid::int3x3 },
+	{ "int4", tokenid::int4 },
+	{ "int4x4", tokenid::int4x4 },
+	{ "interface", tokenid::reserved },
+	{ "linear", tokenid::linear },
+	{ "long", tokenid::reserved },
+	{ "matrix", tokenid::matrix },
+	{ "min16float", tokenid::min16float },
+	{ "min16float2", tokenid::min16float2 },
+	{ "min16float2x2", tokenid::min16float2x2 },
+	{ "min16float3", tokenid::min16float3 },
+	{ "min16float3x3", tokenid::min16float3x3 },
+	{ "min16float4", tokenid::min16float4 },
+	{ "min16float4x4", tokenid::min16float4x4 },
+	{ "mutable", tokenid::reserved },
+	{ "namespace", tokenid::namespace_ },
+	{ "new", tokenid::reserved },
+	{ "noinline", tokenid::reserved },
+	{ "nointerpolation", tokenid::nointerpolation },
+	{ "noperspective", tokenid::noperspective },
+	{ "operator", tokenid::reserved },
+	{ "out", tokenid::out },
+	{ "packed", tokenid::reserved },
+	{ "packoffset", tokenid::reserved },
+	{ "pass", tokenid::pass },
+	{ "precise", tokenid::precise },
+	{ "private", tokenid::reserved },
+	{ "protected", tokenid::reserved },
+	{ "public", tokenid::reserved },
+	{ "register", tokenid::reserved },
+	{ "reinterpret_cast", tokenid::reserved },
+	{ "return", tokenid::return_ },
+	{ "row_major", tokenid::reserved },
+	{ "sample", tokenid::reserved },
+	{ "sampler", tokenid::sampler },
+	{ "sampler1D", tokenid::sampler },
+	{ "sampler1DArray", tokenid::reserved },
+	{ "sampler1DArrayShadow", tokenid::reserved },
+	{ "sampler1DShadow", tokenid::reserved },
+	{ "sampler2D", tokenid::sampler },
+	{ "sampler2DArray", tokenid::reserved },
+	{ "sampler2DArrayShadow", tokenid::reserved },
+	{ "sampler2DMS", tokenid::reserved },
+	{ "sampler2DMSArray", tokenid::reserved },
+	{ "sampler2DShadow", tokenid::reserved },
+	{ "sampler3D", tokenid::sampler },
+	{ "sampler_state", tokenid::reserved },
+	{ "samplerCUBE", tokenid::reserved },
+	{ "samplerRECT", tokenid::reserved },
+	{ "SamplerState", tokenid::reserved },
+	{ "shared", tokenid::reserved },
+	{ "short", tokenid::reserved },
+	{ "signed", tokenid::reserved },
+	{ "sizeof", tokenid::reserved },
+	{ "snorm", tokenid::reserved },
+	{ "static", tokenid::static_ },
+	{ "static_cast", tokenid::reserved },
+	{ "string", tokenid::string_ },
+	{ "struct", tokenid::struct_ },
+	{ "switch", tokenid::switch_ },
+	{ "technique", tokenid::technique },
+	{ "template", tokenid::reserved },
+	{ "texture", tokenid::texture },
+	{ "Texture1D", tokenid::reserved },
+	{ "texture1D", tokenid::texture },
+	{ "Texture1DArray", tokenid::reserved },
+	{ "Texture2D", tokenid::reserved },
+	{ "texture2D", tokenid::texture },
+	{ "Texture2DArray", tokenid::reserved },
+	{ "Texture2DMS", tokenid::reserved },
+	{ "Texture2DMSArray", tokenid::reserved },
+	{ "Texture3D", tokenid::reserved },
+	{ "texture3D", tokenid::texture },
+	{ "textureCUBE", tokenid::reserved },
+	{ "TextureCube", tokenid::reserved },
+	{ "TextureCubeArray", tokenid::reserved },
+	{ "textureRECT", tokenid::reserved },
+	{ "this", tokenid::reserved },
+	{ "true", tokenid::true_literal },
+	{ "TRUE", tokenid::true_literal },
+	{ "try", tokenid::reserved },
+	{ "typedef", tokenid::reserved },
+	{ "uint", tokenid::uint_ },
+	{ "uint2", tokenid::uint2 },
+	{ "uint2x2", tokenid::uint2x2 },
+	{ "uint3", tokenid::uint3 },
+	{ "uint3x3", tokenid::uint3x3 },
+	{ "uint4", tokenid::uint4 },
+	{ "uint4x4", tokenid::uint4x4 },
+	{ "uniform", tokenid::uniform_ },
+	{ "union", tokenid::reserved },
+	{ "unorm", tokenid::reserved },
+	{ "unsigned", tokenid::reserved },
+	{ "vector", tokenid::vector },
+	{ "virtual", tokenid::reserved },
+	{ "void", tokenid::void_ },
+	{ "volatile", tokenid::volatile_ },
+	{ "while", tokenid::while_ },
+};
+static const std::unordered_map<std::string, tokenid> pp_directive_lookup = {
+	{ "define", tokenid::hash_def },
+	{ "undef", tokenid::hash_undef },
+	{ "if", tokenid::hash_if },
+	{ "ifdef", tokenid::hash_ifdef },
+	{ "ifndef", tokenid::hash_ifndef },
+	{ "else", tokenid::hash_else },
+	{ "elif", tokenid::hash_elif },
+	{ "endif", tokenid::hash_endif },
+	{ "error", tokenid::hash_error },
+	{ "warning", tokenid::hash_warning },
+	{ "pragma", tokenid::hash_pragma },
+	{ "include", tokenid::hash_include },
+};
+
+static unsigned int failures = 0;
+
+static void check_word(lexer &lexer, const std::string &word)
+{
+	tokenid expected = tokenid::identifier;
+	if (const auto it = keyword_lookup.find(word); it != keyword_lookup.end())
+		expected = it->second;
+
+	lexer.reset(word);
+	const token tok = lexer.lex();
+
+	if (tok.id != expected || (expected == tokenid::identifier && tok.literal_as_string != word))
+	{
+		printf("'%s' was lexed as %s (%d), but should be %s (%d)\n", word.c_str(), token::id_to_name(tok.id).c_str(), static_cast<int>(tok.id), token::id_to_name(expected).c_str(), static_cast<int>(expected));
+		failures++;
+	}
+}
+
+static void check_directive(lexer &lexer, const std::string &name)
+{
+	tokenid expected = tokenid::hash_unknown;
+	if (const auto it = pp_directive_lookup.find(name); it != pp_directive_lookup.end())
+		expected = it->second;
+
+	lexer.reset('#' + name + '\n');
+	const token tok = lexer.lex();
+
+	if (tok.id != expected)
+	{
+		printf("'#%s' was lexed as %s (%d), but should be %s (%d)\n", name.c_str(), token::id_to_name(tok.id).c_str(), static_cast<int>(tok.id), token::id_to_name(expected).c_str(), static_cast<int>(expected));
+		failures++;
+	}
+}
+
+static void check_variations(lexer &lexer, const std::string &word, void(*check)(reshadefx::lexer &, const std::string &))
+{
+	check(lexer, word);
+
+	std::string variation = word;
+	variation[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(variation[0])));
+	check(lexer, variation);
+	for (char &c : variation)
+		c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+	check(lexer, variation);
+
+	check(lexer, '_' + word);
+	check(lexer, word + '_');
+	check(lexer, word + '1');
+	check(lexer, word + word);
+
+	if (word.size() > 1)
+	{
+		check(lexer, word.substr(1));
+		check(lexer, word.substr(0, word.size() - 1));
+	}
+}
+
+int main()
+{
+	lexer keyword_lexer(std::string(), true, true, true);
+	lexer directive_lexer(std::string(), true, true, false);
+
+	for (const auto &[word, id] : keyword_lookup)
+		check_variations(keyword_lexer, word, check_word);
+	for (const auto &[name, id] : pp_directive_lookup)
+		check_variations(directive_lexer, name, check_directive);
+
+	// Lots of short identifiers, which hit every slot of the hash tables many times
+	const char alphabet[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+	for (size_t length = 1, count = 27; length <= 3; ++length, count *= 37)
+	{
+		std::string word(length, 'a');
+		for (size_t i = 0; i < count; ++i)
+		{
+			size_t value = i;
+			word[0] = alphabet[value % 27], value /= 27; // Identifiers cannot start with a digit
+			for (size_t k = 1; k < length; ++k)
+				word[k] = alphabet[value % 37], value /= 37;
+
+			check_word(keyword_lexer, word);
+			check_directive(directive_lexer, word);
+		}
+	}
+
+	if (failures != 0)
+	{
+		printf("%u checks failed\n", failures);
+		return 1;
+	}
+
+	printf("All %zu keywords and %zu directives are recognized.\n", keyword_lookup.size(), pp_directive_lookup.size());
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Checks that compiled effect modules survive a round-trip through 'reshadefx::write_module' and 'reshadefx::read_module' and compares the time it takes to load a module with the time it takes to compile it.
+// Every effect is compiled with all three code generators. For each module this checks that:
+//   - writing, reading and writing again produces the same data
+//   - the module that was read matches the compiled one
+//   - every truncated version of the data is rejected
+//
+// Build it like fxc (it needs the ReShadeFX library), then run:
+//   check_module [-I <path>] [-n <runs>] <filename> ...
+
+#include "effect_parser.hpp"
+#include "effect_codegen.hpp"
+#include "effect_module.hpp"
+#include "effect_preprocessor.hpp"
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <tuple>
+#include <filesystem>
+#include <functional>
+
+// Compiles an effect the same way the runtime does, which optimizes the code before it is passed on to the back-end
+static bool compile(const std::filesystem::path &path, const std::vector<std::filesystem::path> &include_paths, reshadefx::codegen *backend, reshadefx::module &module, std::string &errors)
+{
+	reshadefx::preprocessor pp;
+	for (const std::filesystem::path &include_path : include_paths)
+		pp.add_include_path(include_path);
+	pp.add_macro_definition("BUFFER_WIDTH", "800");
+	pp.add_macro_definition("BUFFER_HEIGHT", "600");
+	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+
+	const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_ir({ backend }, true, 1024));
+
+	reshadefx::parser parser;
+	const bool success = pp.append_file(path) && parser.parse(pp.output(), codegen.get());
+	errors = pp.errors() + parser.errors();
+	if (success)
+		codegen->write_result(module);
+	return success;
+}
+
+static bool compare_modules(const reshadefx::module &a, const reshadefx::module &b)
+{
+	const auto same_annotations = [](const std::unordered_map<std::string, std::pair<reshadefx::type, reshadefx::constant>> &a, const std::unordered_map<std::string, std::pair<reshadefx::type, reshadefx::constant>> &b) {
+		if (a.size() != b.size())
+			return false;
+		for (const auto &[name, value] : a)
+			if (const auto it = b.find(name); it == b.end() || it->second.first != value.first || it->second.second.string_data != value.second.string_data ||
+				std::memcmp(it->second.second.as_uint, value.second.as_uint, sizeof(value.second.as_uint)) != 0)
+				return false;
+		return true;
+	};
+
+	const auto same_pass = [](const reshadefx::pass_info &a, const reshadefx::pass_info &b) {
+		const auto state = [](const reshadefx::pass_info &pass) {
+			return std::tie(pass.vs_entry_point, pass.ps_entry_point, pass.clear_render_targets, pass.srgb_write_enable, pass.blend_enable, pass.stencil_enable, pass.color_write_mask, pass.stencil_read_mask, pass.stencil_write_mask,
+				pass.blend_op, pass.blend_op_alpha, pass.src_blend, pass.dest_blend, pass.src_blend_alpha, pass.dest_blend_alpha, pass.stencil_comparison_func, pass.stencil_reference_value,
+				pass.stencil_op_pass, pass.stencil_op_fail, pass.stencil_op_depth_fail, pass.num_vertices, pass.viewport_width, pass.viewport_height);
+		};
+		return state(a) == state(b) && std::equal(std::begin(a.render_target_names), std::end(a.render_target_names), std::begin(b.render_target_names));
+	};
+
+	if (a.hlsl != b.hlsl || a.spirv != b.spirv || a.num_sampler_bindings != b.num_sampler_bindings || a.num_texture_bindings != b.num_texture_bindings ||
+		a.entry_points.size() != b.entry_points.size() || a.textures.size() != b.textures.size() || a.samplers.size() != b.samplers.size() ||
+		a.uniforms.size() != b.uniforms.size() || a.spec_constants.size() != b.spec_constants.size() || a.techniques.size() != b.techniques.size())
+		return false;
+
+	for (size_t i = 0; i < a.entry_points.size(); ++i)
+		if (a.entry_points[i].name != b.entry_points[i].name || a.entry_points[i].is_pixel_shader != b.entry_points[i].is_pixel_shader || a.entry_points[i].assembly != b.entry_points[i].assembly)
+			return false;
+	for (size_t i = 0; i < a.textures.size(); ++i)
+		if (a.textures[i].unique_name != b.textures[i].unique_name || a.textures[i].semantic != b.textures[i].semantic || a.textures[i].width != b.textures[i].width || a.textures[i].height != b.textures[i].height ||
+			a.textures[i].levels != b.textures[i].levels || a.textures[i].format != b.textures[i].format || !same_annotations(a.textures[i].annotations, b.textures[i].annotations))
+			return false;
+	for (size_t i = 0; i < a.samplers.size(); ++i)
+		if (a.samplers[i].unique_name != b.samplers[i].unique_name || a.samplers[i].texture_name != b.samplers[i].texture_name || a.samplers[i].binding != b.samplers[i].binding ||
+			a.samplers[i].filter != b.samplers[i].filter ||
+			a.samplers[i].address_u != b.samplers[i].address_u || a.samplers[i].address_v != b.samplers[i].address_v || a.samplers[i].address_w != b.samplers[i].address_w || a.samplers[i].srgb != b.samplers[i].srgb || !same_annotations(a.samplers[i].annotations, b.samplers[i].annotations))
+			return false;
+	for (size_t i = 0; i < a.uniforms.size() + a.spec_constants.size(); ++i)
+		if (const reshadefx::uniform_info &ua = i < a.uniforms.size() ? a.uniforms[i] : a.spec_constants[i - a.uniforms.size()], &ub = i < b.uniforms.size() ? b.uniforms[i] : b.spec_constants[i - b.uniforms.size()];
+			ua.name != ub.name || ua.type != ub.type || ua.offset != ub.offset || ua.size != ub.size || ua.has_initializer_value != ub.has_initializer_value ||
+			std::memcmp(ua.initializer_value.as_uint, ub.initializer_value.as_uint, sizeof(ua.initializer_value.as_uint)) != 0 || !same_annotations(ua.annotations, ub.annotations))
+			return false;
+	for (size_t i = 0; i < a.techniques.size(); ++i)
+	{
+		if (a.techniques[i].name != b.techniques[i].name || a.techniques[i].passes.size() != b.techniques[i].passes.size() || !same_annotations(a.techniques[i].annotations, b.techniques[i].annotations))
+			return false;
+		for (size_t k = 0; k < a.techniques[i].passes.size(); ++k)
+			if (!same_pass(a.techniques[i].passes[k], b.techniques[i].passes[k]))
+				return false;
+	}
+
+	return true;
+}
+
+// Returns the best time in milliseconds out of several runs
+static double measure(unsigned int runs, const std::function<void()> &func)
+{
+	double best = std::numeric_limits<double>::max();
+	for (unsigned int i = 0; i < runs; ++i)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		func();
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int runs = 10;
+	std::vector<std::filesystem::path> files, include_paths;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (0 == strcmp(argv[i], "-I") && i + 1 < argc)
+			include_paths.push_back(argv[++i]);
+		else if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+			runs = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+		else
+			files.push_back(argv[i]);
+	}
+
+	if (files.empty())
+	{
+		printf("usage: %s [-I <path>] [-n <runs>] <filename> ...\n", argv[0]);
+		return 1;
+	}
+
+	const struct { const char *name; std::function<reshadefx::codegen *()> create; } targets[] = {
+		{ "hlsl", []() { return reshadefx::create_codegen_hlsl(50, true, false); } },
+		{ "glsl", []() { return reshadefx::create_codegen_glsl(true, false); } },
+		{ "spirv", []() { return reshadefx::create_codegen_spirv(true, true, false); } },
+	};
+
+	unsigned int failures = 0;
+
+	for (const std::filesystem::path &path : files)
+	{
+		for (const auto &target : targets)
+		{
+			std::string errors;
+			reshadefx::module module;
+			if (const std::unique_ptr<reshadefx::codegen> backend(target.create()); !compile(path, include_paths, backend.get(), module, errors))
+			{
+				printf("%s (%s): failed to compile:\n%s\n", path.u8string().c_str(), target.name, errors.c_str());
+				failures++;
+				continue;
+			}
+
+			std::string data, data_again;
+			reshadefx::write_module(module, data);
+
+			reshadefx::module loaded_module;
+			const char *error = nullptr;
+			if (!reshadefx::read_module(data, loaded_module))
+				error = "could not read the written data";
+			else if (!compare_modules(module, loaded_module))
+				error = "the module that was read does not match the compiled one";
+			else if (reshadefx::write_module(loaded_module, data_again), data_again != data)
+				error = "writing the module that was read gives different data";
+
+			for (size_t size = 0; error == nullptr && size < data.size(); ++size)
+				if (reshadefx::module truncated_module; reshadefx::read_module(std::string_view(data.data(), size), truncated_module))
+					error = "a truncated version of the data was accepted";
+
+			if (error != nullptr)
+			{
+				printf("%s (%s): %s\n", path.u8string().c_str(), target.name, error);
+				failures++;
+				continue;
+			}
+
+			const double compile_time = measure(runs, [&]() {
+				const std::unique_ptr<reshadefx::codegen> backend(target.create());
+				reshadefx::module compiled_module;
+				compile(path, include_paths, backend.get(), compiled_module, errors);
+			});
+			const double load_time = measure(runs, [&]() {
+				loaded_module = reshadefx::module();
+				reshadefx::read_module(data, loaded_module);
+			});
+
+			printf("%s (%s): %zu bytes, %.3f ms to compile, %.3f ms to load\n", path.u8string().c_str(), target.name, data.size(), compile_time, load_time);
+		}
+	}
+
+	if (failures != 0)
+		printf("%u checks failed\n", failures);
+
+	return failures != 0 ? 1 : 0;
+}
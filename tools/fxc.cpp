@@ -7,13 +7,23 @@
 #include "effect_codegen.hpp"
 #include "effect_preprocessor.hpp"
 #include "version.h"
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <thread>
 #include <vector>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <unordered_set>
 
 static void print_usage(const char *path)
 {
 	printf(R"(usage: %s [options] <filename>
+       %s --batch [options] <filename or directory> ...
 
 Options:
   -h, --help                Print this help.
@@ -25,35 +35,166 @@ Options:
 
   -Fo <file>                Output SPIR-V binary to the given file.
   -Fe <file>                Output warnings and errors to the given file.
+  --glsl-file <file>        Output GLSL code to the given file.
+  --hlsl-file <file>        Output HLSL code for the previously specified shader model to the given file. Can be used multiple times.
 
   --glsl                    Print GLSL code for the previously specified entry point.
   --hlsl                    Print HLSL code for the previously specified entry point.
   --shader-model <value>    HLSL shader model version. Can be 30, 40, 41, 50, ...
+  --size-report             Print how much code was left out because no entry point uses it.
 
   --width                   Value of the 'BUFFER_WIDTH' preprocessor macro.
   --height                  Value of the 'BUFFER_HEIGHT' preprocessor macro.
 
+  -Od                       Disable optimizations.
+  --unroll-limit <count>    Maximum number of instructions a loop may grow to when it is unrolled. Defaults to 1024.
   -Zi                       Enable debug information.
-	)", path);
+
+  --batch                   Compile all given files and all effect files in the given directories in parallel.
+                            Errors are printed for each file in the order they were given, the target is chosen with --glsl and --hlsl.
+  -j <count>                Number of threads to compile with in batch mode. Defaults to the number of processor cores.
+  --out-dir <path>          Write the compiled code of each file in batch mode to this directory. Input file names have to be unique then.
+  --report <file>           Write a JSON report with the timings and output size of each file in batch mode to the given file.
+	)", path, path);
+}
+
+struct batch_file
+{
+	std::filesystem::path path;
+	bool success = false;
+	std::string errors;
+	double preprocess_time = 0.0; // Milliseconds
+	double parse_time = 0.0;
+	double codegen_time = 0.0;
+	size_t output_size = 0;
+};
+
+static double elapsed_milliseconds(std::chrono::high_resolution_clock::time_point &start)
+{
+	const auto now = std::chrono::high_resolution_clock::now();
+	const double elapsed = std::chrono::duration<double, std::milli>(now - start).count();
+	start = now;
+	return elapsed;
+}
+
+static std::string escape_json_string(const std::string &s)
+{
+	std::string result;
+	result.reserve(s.size() + 2);
+	result += '"';
+	for (const char c : s)
+	{
+		switch (c)
+		{
+		case '"':
+			result += "\\\"";
+			break;
+		case '\\':
+			result += "\\\\";
+			break;
+		case '\n':
+			result += "\\n";
+			break;
+		case '\r':
+			result += "\\r";
+			break;
+		case '\t':
+			result += "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char code[8];
+				snprintf(code, sizeof(code), "\\u%04x", c);
+				result += code;
+			}
+			else
+			{
+				result += c;
+			}
+			break;
+		}
+	}
+	result += '"';
+	return result;
+}
+
+static void run_parallel(size_t num_jobs, size_t num_threads, const std::function<void(size_t)> &job)
+{
+	struct job_queue
+	{
+		std::mutex mutex;
+		std::deque<size_t> jobs;
+	};
+
+	// Every thread starts out with a contiguous share of the jobs and works through it from the front
+	std::vector<job_queue> queues(num_threads);
+	for (size_t i = 0; i < num_jobs; ++i)
+		queues[i * num_threads / num_jobs].jobs.push_back(i);
+
+	std::vector<std::thread> threads;
+	for (size_t n = 0; n < num_threads; ++n)
+		threads.emplace_back([&queues, &job, num_threads, n]() {
+			while (true)
+			{
+				size_t index = std::numeric_limits<size_t>::max();
+
+				if (const std::lock_guard<std::mutex> lock(queues[n].mutex); !queues[n].jobs.empty())
+				{
+					index = queues[n].jobs.front();
+					queues[n].jobs.pop_front();
+				}
+
+				// Once its own share is done, a thread steals from the back of the others, so that a few large files cannot keep a single thread busy while the rest sit idle
+				for (size_t k = 1; k < num_threads && index == std::numeric_limits<size_t>::max(); ++k)
+				{
+					job_queue &victim = queues[(n + k) % num_threads];
+					if (const std::lock_guard<std::mutex> lock(victim.mutex); !victim.jobs.empty())
+					{
+						index = victim.jobs.back();
+						victim.jobs.pop_back();
+					}
+				}
+
+				// No new jobs are added after the start, so there is nothing left to do once all queues are empty
+				if (index == std::numeric_limits<size_t>::max())
+					break;
+
+				job(index);
+			}
+		});
+
+	for (std::thread &thread : threads)
+		thread.join();
 }
 
 int main(int argc, char *argv[])
 {
-	const char *filename = nullptr;
+	std::vector<const char *> filenames;
 	const char *preprocess = nullptr;
 	const char *errorfile = nullptr;
 	const char *objectfile = nullptr;
+	const char *glsl_file = nullptr;
+	std::vector<std::pair<const char *, unsigned int>> hlsl_files;
 	const char *buffer_width = "800";
 	const char *buffer_height = "600";
 	bool print_glsl = false;
 	bool print_hlsl = false;
 	bool debug_info = false;
+	bool optimize = true;
+	unsigned int unroll_limit = 1024;
+	bool size_report = false;
 	unsigned int shader_model = 50;
+	bool batch = false;
+	size_t num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	const char *output_dir = nullptr;
+	const char *report_file = nullptr;
 
-	reshadefx::parser parser;
-	reshadefx::preprocessor pp;
-	pp.add_macro_definition("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
-	pp.add_macro_definition("__RESHADE_PERFORMANCE_MODE__", "0");
+	// Collect macros and include paths first, since batch mode needs a separate preprocessor for every file
+	std::vector<std::pair<std::string, std::string>> macros;
+	std::vector<std::filesystem::path> include_paths;
+	macros.emplace_back("__RESHADE__", std::to_string(VERSION_MAJOR * 10000 + VERSION_MINOR * 100 + VERSION_REVISION));
+	macros.emplace_back("__RESHADE_PERFORMANCE_MODE__", "0");
 
 	// Parse command-line arguments
 	for (int i = 1; i < argc; ++i)
@@ -76,22 +217,28 @@ int main(int argc, char *argv[])
 				char *macro = argv[++i];
 				char *value = strchr(macro, '=');
 				if (value) *value++ = '\0';
-				pp.add_macro_definition(macro, value ? value : "1");
+				macros.emplace_back(macro, value ? value : "1");
 				continue;
 			}
 
 			if (0 == strcmp(arg, "-I"))
 			{
-				pp.add_include_path(argv[++i]);
+				include_paths.push_back(argv[++i]);
 				continue;
 			}
 
 			if (0 == strcmp(arg, "-Zi"))
 				debug_info = true;
+			else if (0 == strcmp(arg, "-Od"))
+				optimize = false;
 			else if (0 == strcmp(arg, "--glsl"))
 				print_glsl = true;
 			else if (0 == strcmp(arg, "--hlsl"))
 				print_hlsl = true;
+			else if (0 == strcmp(arg, "--size-report"))
+				size_report = true;
+			else if (0 == strcmp(arg, "--batch"))
+				batch = true;
 
 			if (i + 1 >= argc)
 				break;
@@ -101,35 +248,218 @@ int main(int argc, char *argv[])
 				errorfile = argv[++i];
 			else if (0 == strcmp(arg, "-Fo"))
 				objectfile = argv[++i];
+			else if (0 == strcmp(arg, "--glsl-file"))
+				glsl_file = argv[++i];
+			else if (0 == strcmp(arg, "--hlsl-file"))
+				hlsl_files.emplace_back(argv[++i], shader_model);
 			else if (0 == strcmp(arg, "--shader-model"))
 				shader_model = std::strtol(argv[++i], nullptr, 10);
 			else if (0 == strcmp(arg, "--width"))
 				buffer_width = argv[++i];
 			else if (0 == strcmp(arg, "--height"))
 				buffer_height = argv[++i];
+			else if (0 == strcmp(arg, "--unroll-limit"))
+				unroll_limit = std::strtoul(argv[++i], nullptr, 10);
+			else if (0 == strcmp(arg, "-j"))
+				num_threads = std::max(std::strtol(argv[++i], nullptr, 10), 1l);
+			else if (0 == strcmp(arg, "--out-dir"))
+				output_dir = argv[++i];
+			else if (0 == strcmp(arg, "--report"))
+				report_file = argv[++i];
 		}
 		else
 		{
-			if (filename != nullptr)
+			if (!filenames.empty() && !batch)
 			{
 				std::cout << "error: More than one input file specified" << std::endl;
 				return 1;
 			}
 
-			filename = arg;
+			filenames.push_back(arg);
 		}
 	}
 
-	if (filename == nullptr)
+	if (filenames.empty())
 	{
 		print_usage(argv[0]);
 		return 1;
 	}
 
-	pp.add_macro_definition("BUFFER_WIDTH", buffer_width);
-	pp.add_macro_definition("BUFFER_HEIGHT", buffer_height);
-	pp.add_macro_definition("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
-	pp.add_macro_definition("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+	macros.emplace_back("BUFFER_WIDTH", buffer_width);
+	macros.emplace_back("BUFFER_HEIGHT", buffer_height);
+	macros.emplace_back("BUFFER_RCP_WIDTH", "(1.0 / BUFFER_WIDTH)");
+	macros.emplace_back("BUFFER_RCP_HEIGHT", "(1.0 / BUFFER_HEIGHT)");
+
+	const auto create_backend = [&]() -> reshadefx::codegen * {
+		if (print_glsl)
+			return reshadefx::create_codegen_glsl(debug_info, false);
+		else if (print_hlsl)
+			return reshadefx::create_codegen_hlsl(shader_model, debug_info, false);
+		else
+			return reshadefx::create_codegen_spirv(true, debug_info, false);
+	};
+
+	if (batch)
+	{
+		if (preprocess != nullptr || objectfile != nullptr || glsl_file != nullptr || !hlsl_files.empty() || size_report)
+		{
+			std::cout << "error: -P, -Fo, --glsl-file, --hlsl-file and --size-report cannot be used in batch mode" << std::endl;
+			return 1;
+		}
+
+		// Build the list of files, directories contribute all effect files directly inside them
+		std::vector<batch_file> files;
+		for (const char *filename : filenames)
+		{
+			std::error_code ec;
+			if (std::filesystem::is_directory(filename, ec))
+			{
+				std::vector<std::filesystem::path> directory_files;
+				for (const auto &entry : std::filesystem::directory_iterator(filename, ec))
+					if (entry.path().extension() == ".fx")
+						directory_files.push_back(entry.path());
+				// Sort the directory entries, so that the order of errors and the report does not depend on the file system
+				std::sort(directory_files.begin(), directory_files.end());
+
+				for (std::filesystem::path &path : directory_files)
+					files.push_back({ std::move(path) });
+			}
+			else
+			{
+				files.push_back({ filename });
+			}
+		}
+
+		if (files.empty())
+		{
+			std::cout << "error: No effect files found" << std::endl;
+			return 1;
+		}
+
+		// Output files are named after the input files only, so two inputs with the same name (e.g. from different directories) would overwrite each other
+		if (output_dir != nullptr)
+		{
+			std::unordered_set<std::string> output_names;
+			for (const batch_file &file : files)
+			{
+				std::string name = file.path.filename().u8string();
+				std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+				if (!output_names.insert(std::move(name)).second)
+				{
+					std::cout << "error: More than one input file is named '" << file.path.filename().u8string() << "', which would result in the same output file in " << output_dir << std::endl;
+					return 1;
+				}
+			}
+		}
+
+		num_threads = std::min(num_threads, files.size());
+
+		const auto batch_start = std::chrono::high_resolution_clock::now();
+
+		// The include cache is shared by all preprocessor instances, so headers used by many effects are only read from disk once
+		reshadefx::preprocessor::reset_include_cache_statistics();
+
+		run_parallel(files.size(), num_threads, [&](size_t index) {
+			batch_file &file = files[index];
+			auto start = std::chrono::high_resolution_clock::now();
+
+			reshadefx::preprocessor pp;
+			for (const std::filesystem::path &include_path : include_paths)
+				pp.add_include_path(include_path);
+			for (const auto &[name, value] : macros)
+				pp.add_macro_definition(name, value);
+
+			file.success = pp.append_file(file.path);
+			file.preprocess_time = elapsed_milliseconds(start);
+
+			const std::unique_ptr<reshadefx::codegen> backend(create_backend());
+			const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_ir({ backend.get() }, optimize, unroll_limit));
+
+			// Try to compile even if the preprocessor step failed to get additional error information
+			reshadefx::parser parser;
+			if (!parser.parse(std::move(pp.output()), codegen.get()))
+				file.success = false;
+			file.parse_time = elapsed_milliseconds(start);
+
+			file.errors = std::move(pp.errors()) + std::move(parser.errors());
+
+			if (!file.success)
+				return;
+
+			reshadefx::module module;
+			codegen->write_result(module);
+			file.codegen_time = elapsed_milliseconds(start);
+
+			file.output_size = (print_glsl || print_hlsl) ? module.hlsl.size() : module.spirv.size() * sizeof(uint32_t);
+
+			if (output_dir != nullptr)
+			{
+				std::filesystem::path output_path = std::filesystem::u8path(output_dir) / file.path.filename();
+				output_path += print_glsl ? ".glsl" : print_hlsl ? ".hlsl" : ".spv";
+
+				if (print_glsl || print_hlsl)
+					std::ofstream(output_path) << module.hlsl;
+				else
+					std::ofstream(output_path, std::ios::binary).write(
+						reinterpret_cast<const char *>(module.spirv.data()), module.spirv.size() * sizeof(uint32_t));
+			}
+		});
+
+		const double total_time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - batch_start).count();
+
+		size_t num_failed = 0;
+		std::ofstream errorstream;
+		if (errorfile != nullptr)
+			errorstream.open(errorfile);
+		std::ostream &errors = errorfile != nullptr ? errorstream : std::cout;
+		for (const batch_file &file : files)
+		{
+			if (!file.success)
+			{
+				num_failed++;
+				errors << "error: Failed to compile " << file.path.u8string() << std::endl;
+			}
+			errors << file.errors;
+		}
+
+		std::cout << "Compiled " << (files.size() - num_failed) << " of " << files.size() << " files using " << num_threads << " threads in " << std::fixed << std::setprecision(1) << total_time << " ms" << std::endl;
+
+		if (report_file != nullptr)
+		{
+			std::ofstream report(report_file);
+			report << std::fixed << std::setprecision(3);
+			report << "{\n";
+			report << "  \"threads\": " << num_threads << ",\n";
+			report << "  \"total_ms\": " << total_time << ",\n";
+			report << "  \"include_cache_hits\": " << reshadefx::preprocessor::include_cache_hits() << ",\n";
+			report << "  \"include_cache_misses\": " << reshadefx::preprocessor::include_cache_misses() << ",\n";
+			report << "  \"files\": [";
+			for (size_t i = 0; i < files.size(); ++i)
+			{
+				const batch_file &file = files[i];
+				report << (i == 0 ? "\n" : ",\n");
+				report << "    { \"path\": " << escape_json_string(file.path.u8string())
+					<< ", \"success\": " << (file.success ? "true" : "false")
+					<< ", \"preprocess_ms\": " << file.preprocess_time
+					<< ", \"parse_ms\": " << file.parse_time
+					<< ", \"codegen_ms\": " << file.codegen_time
+					<< ", \"output_size\": " << file.output_size
+					<< ", \"errors\": " << escape_json_string(file.errors) << " }";
+			}
+			report << "\n  ]\n}\n";
+		}
+
+		return num_failed != 0 ? 1 : 0;
+	}
+
+	const char *const filename = filenames[0];
+
+	reshadefx::parser parser;
+	reshadefx::preprocessor pp;
+	for (const std::filesystem::path &include_path : include_paths)
+		pp.add_include_path(include_path);
+	for (const auto &[name, value] : macros)
+		pp.add_macro_definition(name, value);
 
 	if (!pp.append_file(filename))
 	{
@@ -149,15 +479,26 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
-	std::unique_ptr<reshadefx::codegen> backend;
-	if (print_glsl)
-		backend.reset(reshadefx::create_codegen_glsl(debug_info, false));
-	else if (print_hlsl)
-		backend.reset(reshadefx::create_codegen_hlsl(shader_model, debug_info, false));
-	else
-		backend.reset(reshadefx::create_codegen_spirv(true, debug_info, false));
+	const std::unique_ptr<reshadefx::codegen> backend(create_backend());
+
+	// Any additional output files get their own back-ends, which are all fed from the same pass of the parser
+	std::unique_ptr<reshadefx::codegen> glsl_backend;
+	if (glsl_file != nullptr)
+		glsl_backend.reset(reshadefx::create_codegen_glsl(debug_info, false));
+	std::vector<std::unique_ptr<reshadefx::codegen>> hlsl_backends;
+	for (const auto &file : hlsl_files)
+		hlsl_backends.emplace_back(reshadefx::create_codegen_hlsl(file.second, debug_info, false));
 
-	if (!parser.parse(pp.output(), backend.get()))
+	std::vector<reshadefx::codegen *> backends = { backend.get() };
+	if (glsl_backend != nullptr)
+		backends.push_back(glsl_backend.get());
+	for (const auto &hlsl_backend : hlsl_backends)
+		backends.push_back(hlsl_backend.get());
+
+	// Record the code before passing it on to the back-ends, so that it can be optimized first
+	const std::unique_ptr<reshadefx::codegen> codegen(reshadefx::create_codegen_ir(std::move(backends), optimize, unroll_limit));
+
+	if (!parser.parse(pp.output(), codegen.get()))
 	{
 		if (errorfile == nullptr)
 			std::cout << pp.errors() << parser.errors() << std::endl;
@@ -167,7 +508,27 @@ int main(int argc, char *argv[])
 	}
 
 	reshadefx::module module;
-	backend->write_result(module);
+	codegen->write_result(module);
+
+	if (size_report)
+	{
+		const size_t output_size = (print_glsl || print_hlsl) ? module.hlsl.size() : module.spirv.size() * sizeof(uint32_t);
+		const size_t total_size = output_size + codegen->removed_code_size();
+
+		// Write to the error stream, so that this does not mix with code printed to the output stream
+		std::cerr << "Removed " << codegen->num_removed_functions() << " unused functions, reducing the output from " << total_size << " to " << output_size << " bytes ("
+			<< (total_size != 0 ? 100.0 * codegen->removed_code_size() / total_size : 0.0) << "% smaller)" << std::endl;
+
+		if (print_glsl)
+		{
+			size_t entry_point_size = 0;
+			for (const reshadefx::entry_point_info &entry_point : module.entry_points)
+				entry_point_size += entry_point.code.size();
+
+			// Each entry point is compiled separately, so compare against what would have to be compiled when passing the entire output every time
+			std::cerr << "Compiling " << module.entry_points.size() << " entry points separately takes " << entry_point_size << " instead of " << module.entry_points.size() * module.hlsl.size() << " bytes of code" << std::endl;
+		}
+	}
 
 	if (print_glsl || print_hlsl)
 	{
@@ -179,5 +540,19 @@ int main(int argc, char *argv[])
 			reinterpret_cast<const char *>(module.spirv.data()), module.spirv.size() * sizeof(uint32_t));
 	}
 
+	if (glsl_backend != nullptr)
+	{
+		reshadefx::module glsl_module;
+		glsl_backend->write_result(glsl_module);
+		std::ofstream(glsl_file) << glsl_module.hlsl << std::endl;
+	}
+
+	for (size_t i = 0; i < hlsl_backends.size(); ++i)
+	{
+		reshadefx::module hlsl_module;
+		hlsl_backends[i]->write_result(hlsl_module);
+		std::ofstream(hlsl_files[i].first) << hlsl_module.hlsl << std::endl;
+	}
+
 	return 0;
 }
@@ -0,0 +1,116 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Generates a graph of include guarded headers to measure how much text the preprocessor skips for re-included files.
+// Every header includes 12 random earlier ones (or all of them for the first few) and the main file includes all of them, so most include directives hit a header that was already included.
+//
+// Build it as a standalone program (e.g. "cl /std:c++17 /EHsc /O2 gen_include_graph.cpp"), then run:
+//   gen_include_graph <output directory> [header count]
+//   fxc -P - <output directory>/main.fx > NUL
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+
+static void print_usage(const char *path)
+{
+	printf("usage: %s <output directory> [header count]\n", path);
+}
+
+static std::string header_name(size_t index)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "h%03zu.fxh", index);
+	return name;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || argc > 3)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path output_path = argv[1];
+	const size_t header_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 300;
+
+	std::error_code ec;
+	std::filesystem::create_directories(output_path, ec);
+
+	std::vector<std::vector<size_t>> includes(header_count);
+	std::vector<size_t> sizes(header_count);
+
+	// Use a fixed seed, so that the same graph is generated every time
+	unsigned int seed = 12345;
+	const auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (seed >> 16) & 0x7FFF; };
+
+	for (size_t i = 0; i < header_count; ++i)
+	{
+		const size_t include_count = std::min<size_t>(i, 12);
+		while (includes[i].size() < include_count)
+		{
+			const size_t dependency = random() % i;
+			if (std::find(includes[i].begin(), includes[i].end(), dependency) == includes[i].end())
+				includes[i].push_back(dependency);
+		}
+
+		std::string code;
+		code += "#ifndef H" + std::to_string(i) + "_FXH\n";
+		code += "#define H" + std::to_string(i) + "_FXH\n\n";
+		for (size_t dependency : includes[i])
+			code += "#include \"" + header_name(dependency) + "\"\n";
+		code += '\n';
+
+		// Pad every header with a couple of functions, so that lexing it again is not free
+		for (size_t k = 0; k < 13; ++k)
+		{
+			const std::string suffix = std::to_string(i) + '_' + std::to_string(k);
+			code += "// Helper function " + suffix + ", which exists only to give the header some size\n";
+			code += "float h" + suffix + "(float x, float y)\n{\n\treturn x * " + std::to_string(k + 1) + ".0 + y * " + std::to_string(i + 1) + ".0;\n}\n";
+		}
+
+		code += "\n#endif\n";
+
+		sizes[i] = code.size();
+		std::ofstream(output_path / header_name(i), std::ios::binary).write(code.data(), code.size());
+	}
+
+	std::string main_code;
+	for (size_t i = 0; i < header_count; ++i)
+		main_code += "#include \"" + header_name(i) + "\"\n";
+	std::ofstream(output_path / "main.fx", std::ios::binary).write(main_code.data(), main_code.size());
+
+	// Walk the graph like the preprocessor does: A header is only read the first time, since its guard hides the include directives in it afterwards
+	size_t directive_count = 0;
+	size_t lexed_bytes = main_code.size();
+	size_t lexed_bytes_with_skipping = main_code.size();
+	std::vector<bool> included(header_count);
+	const std::function<void(size_t)> include = [&](size_t index) {
+		directive_count++;
+		lexed_bytes += sizes[index];
+		if (included[index])
+			return;
+		included[index] = true;
+		lexed_bytes_with_skipping += sizes[index];
+		for (size_t dependency : includes[index])
+			include(dependency);
+	};
+
+	for (size_t i = 0; i < header_count; ++i)
+		include(i);
+
+	printf("Generated %zu headers in '%s'.\n", header_count, output_path.u8string().c_str());
+	printf("  include directives executed:       %zu\n", directive_count);
+	printf("  bytes lexed without guard skipping: %.2f MB\n", lexed_bytes / 1000000.0);
+	printf("  bytes lexed with guard skipping:    %.2f MB\n", lexed_bytes_with_skipping / 1000000.0);
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Generates an effect file that consists mostly of intrinsic function calls, to measure the cost of resolving them in the symbol table.
+// The calls use the intrinsics common in effects (texture sampling, lerp, saturate, dot, ...) with scalar and vector arguments of different types, so that overload resolution has to rank several candidates for most of them.
+//
+// Build it as a standalone program (e.g. "cl /std:c++17 /EHsc /O2 gen_intrinsic_calls.cpp"), then run:
+//   gen_intrinsic_calls <output file> [call count]
+//   fxc --hlsl <output file> > NUL
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+static void print_usage(const char *path)
+{
+	printf("usage: %s <output file> [call count]\n", path);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || argc > 3)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const size_t call_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+
+	// Each statement makes the given number of intrinsic calls
+	static const struct { const char *code; size_t calls; } statements[] = {
+		{ "c = tex2D(s, uv + float2(%zu.0, 0.0) * 0.001);", 1 },
+		{ "c.rgb = lerp(c.rgb, saturate(c.rgb * %zu.0), 0.5);", 2 },
+		{ "l = dot(c.rgb, float3(0.2126, 0.7152, 0.0722)) + %zu.0;", 1 },
+		{ "c = max(c, min(c * %zu.0, 1.0));", 2 },
+		{ "i = clamp(i + %zu, 0, 255);", 1 },
+		{ "u = max(u, %zuu) + abs(i);", 2 },
+		{ "l = pow(abs(l), 2.2) * sqrt(%zu.0) + frac(l);", 4 },
+		{ "c.a = step(0.5, c.a) * smoothstep(0.0, 1.0, l / %zu.0);", 2 },
+		{ "uv = mad(uv, %zu.0, -0.5) + floor(uv);", 2 },
+		{ "l = length(uv - %zu.0) + distance(c.rg, uv);", 2 },
+	};
+
+	std::string code =
+		"texture Tex { Width = 256; Height = 256; };\n"
+		"sampler s { Texture = Tex; };\n"
+		"\n"
+		"float4 PS_Main(float4 vpos : SV_Position, float2 uv : TEXCOORD) : SV_Target\n"
+		"{\n"
+		"\tfloat4 c = 0.0;\n"
+		"\tfloat l = 0.0;\n"
+		"\tint i = 0;\n"
+		"\tuint u = 0u;\n";
+
+	char line[256];
+	size_t num_calls = 0;
+	for (size_t i = 0; num_calls < call_count; ++i)
+	{
+		const auto &statement = statements[i % (sizeof(statements) / sizeof(*statements))];
+		snprintf(line, sizeof(line), statement.code, i);
+		code += '\t';
+		code += line;
+		code += '\n';
+		num_calls += statement.calls;
+	}
+
+	code +=
+		"\treturn c + l + i + u;\n"
+		"}\n"
+		"\n"
+		"float4 VS_Main(uint id : SV_VertexID, out float2 uv : TEXCOORD) : SV_Position\n"
+		"{\n"
+		"\tuv = float2(id == 2 ? 2.0 : 0.0, id == 1 ? 2.0 : 0.0);\n"
+		"\treturn float4(uv * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);\n"
+		"}\n"
+		"\n"
+		"technique IntrinsicCalls\n"
+		"{\n"
+		"\tpass\n"
+		"\t{\n"
+		"\t\tVertexShader = VS_Main;\n"
+		"\t\tPixelShader = PS_Main;\n"
+		"\t}\n"
+		"}\n";
+
+	std::ofstream(argv[1], std::ios::binary).write(code.data(), code.size());
+
+	printf("Generated '%s' with %zu intrinsic calls.\n", argv[1], num_calls);
+
+	return 0;
+}
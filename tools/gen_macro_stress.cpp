@@ -0,0 +1,55 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Generates an effect file that consists mostly of nested function-like macro invocations, to measure the cost of macro expansion in the preprocessor.
+// Every line invokes macros whose arguments and replacement lists contain further macro invocations, so that both argument pre-expansion and rescanning are exercised.
+//
+// Build it as a standalone program (e.g. "cl /std:c++17 /EHsc /O2 gen_macro_stress.cpp"), then run:
+//   gen_macro_stress <output file> [line count]
+//   fxc -P - <output file> > NUL
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+static void print_usage(const char *path)
+{
+	printf("usage: %s <output file> [line count]\n", path);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || argc > 3)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const size_t line_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4000;
+
+	std::string code =
+		"#define A(x) ((x) + 1)\n"
+		"#define B(x, y) (A(x) * A(y))\n"
+		"#define C(x, y, z) (B(x, y) - B(y, z))\n"
+		"#define D(x) C(x, A(x), B(x, x))\n"
+		"\n";
+
+	// B expands to 3 macro invocations (itself and two A) and C to 7 (itself and two B)
+	// D expands to 13, since the 'A(x)' it passes to C is expanded again for every time C uses that argument
+	const size_t expansions_per_line = 13 + 7 + 3;
+
+	for (size_t i = 0; i < line_count; ++i)
+	{
+		const std::string value = std::to_string(i);
+		code += "static const float v" + value + " = D(" + value + ") + C(" + value + ", 2, 3) + B(" + value + ", 4);\n";
+	}
+
+	std::ofstream(argv[1], std::ios::binary).write(code.data(), code.size());
+
+	printf("Generated '%s' with %zu lines and %zu macro expansions.\n", argv[1], line_count, line_count * expansions_per_line);
+
+	return 0;
+}
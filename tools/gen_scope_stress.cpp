@@ -0,0 +1,66 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Generates an effect file with many global symbols and a function with many nested blocks, to measure the cost of leaving a scope in the symbol table.
+// Every block declares a local variable that shadows a global one, so each block adds a symbol that has to be removed again when it is closed, while all the globals stay in the symbol table.
+//
+// Build it as a standalone program (e.g. "cl /std:c++17 /EHsc /O2 gen_scope_stress.cpp"), then run:
+//   gen_scope_stress <output file> [global count] [block count] [nesting depth]
+//   fxc --hlsl <output file> > NUL
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+
+static void print_usage(const char *path)
+{
+	printf("usage: %s <output file> [global count] [block count] [nesting depth]\n", path);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || argc > 5)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const size_t global_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000;
+	const size_t block_count = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 5000;
+	const size_t nesting_depth = argc > 4 ? std::max(1ul, std::strtoul(argv[4], nullptr, 10)) : 50;
+
+	std::string code;
+
+	for (size_t i = 0; i < global_count; ++i)
+		code += "static const float g" + std::to_string(i) + " = " + std::to_string(i) + ".0;\n";
+
+	code += "\nfloat4 PS_Main(float4 vpos : SV_Position) : SV_Target\n{\n\tfloat x = vpos.x;\n";
+
+	// Blocks are nested up to the given depth and then closed again, so that the parser recursion stays bounded for large block counts
+	for (size_t i = 0, depth = 0; i < block_count; ++i)
+	{
+		const std::string name = "g" + std::to_string(global_count != 0 ? i % global_count : i);
+
+		code += std::string(depth + 1, '\t') + "{\n";
+		code += std::string(depth + 2, '\t') + "float " + name + " = x + " + std::to_string(i) + ".0;\n";
+		code += std::string(depth + 2, '\t') + "x = " + name + " * 0.5;\n";
+
+		if (++depth == nesting_depth || i + 1 == block_count)
+			while (depth != 0)
+				code += std::string(depth--, '\t') + "}\n";
+	}
+
+	code += "\treturn x;\n}\n\n";
+	code += "float4 VS_Main(uint id : SV_VertexID) : SV_Position\n{\n\treturn float4(id == 2 ? 3.0 : -1.0, id == 1 ? -3.0 : 1.0, 0.0, 1.0);\n}\n\n";
+	code += "technique ScopeStress\n{\n\tpass\n\t{\n\t\tVertexShader = VS_Main;\n\t\tPixelShader = PS_Main;\n\t}\n}\n";
+
+	std::ofstream(argv[1], std::ios::binary).write(code.data(), code.size());
+
+	printf("Generated '%s' with %zu globals and %zu blocks nested up to %zu deep.\n", argv[1], global_count, block_count, nesting_depth);
+
+	return 0;
+}
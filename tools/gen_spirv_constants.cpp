@@ -0,0 +1,59 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Generates an effect file with many distinct literals and array types, to measure the cost of looking up types and constants in the SPIR-V code generator.
+// Every literal vector and every array size only appears once, so each of them adds a new entry to the constant or type tables that all later lookups have to search.
+//
+// Build it as a standalone program (e.g. "cl /std:c++17 /EHsc /O2 gen_spirv_constants.cpp"), then run:
+//   gen_spirv_constants <output file> [literal count] [array type count]
+//   fxc -Fo NUL <output file>
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+static void print_usage(const char *path)
+{
+	printf("usage: %s <output file> [literal count] [array type count]\n", path);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || argc > 4)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const size_t literal_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+	const size_t array_type_count = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 400;
+
+	std::string code = "float4 PS_Main(float4 vpos : SV_Position) : SV_Target\n{\n\tfloat4 x = vpos;\n";
+
+	// Each vector literal uses four different values, so that neither the vectors nor most of their components are shared
+	for (size_t i = 0; i < literal_count; ++i)
+	{
+		const std::string base = std::to_string(i * 4);
+		code += "\tx = x * float4(" + base + ".25, " + base + ".5, " + base + ".75, " + std::to_string(i * 4 + 1) + ".0) + 1.0;\n";
+	}
+
+	// Arrays of different sizes are different types, as are the constants initializing them
+	for (size_t i = 0; i < array_type_count; ++i)
+	{
+		const std::string size = std::to_string(i + 2);
+		code += "\t{\n\t\tfloat a[" + size + "];\n\t\ta[0] = x.x;\n\t\ta[" + std::to_string(i + 1) + "] = x.y;\n\t\tx.z += a[0] + a[" + std::to_string(i + 1) + "];\n\t}\n";
+	}
+
+	code += "\treturn x;\n}\n\n";
+	code += "float4 VS_Main(uint id : SV_VertexID) : SV_Position\n{\n\treturn float4(id == 2 ? 3.0 : -1.0, id == 1 ? -3.0 : 1.0, 0.0, 1.0);\n}\n\n";
+	code += "technique SpirvConstants\n{\n\tpass\n\t{\n\t\tVertexShader = VS_Main;\n\t\tPixelShader = PS_Main;\n\t}\n}\n";
+
+	std::ofstream(argv[1], std::ios::binary).write(code.data(), code.size());
+
+	printf("Generated '%s' with %zu vector literals and %zu array types.\n", argv[1], literal_count, array_type_count);
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// Compiles every effect file in a directory with fxc and compares the output with what is expected.
+// The first line of each effect file names the fxc options to compile it with (e.g. "// fxc: --hlsl --shader-model 50"), and the expected output is stored next to it in a file with the same name and the extension ".expected".
+// The expected output was checked by hand to be correct, so any difference has to be looked at (and the expected file updated with --update if the new output is correct too).
+//
+// Build it as a standalone program (e.g. "cl /std:c++17 /EHsc /O2 run_fxc_tests.cpp"), then run:
+//   run_fxc_tests <path to fxc> tools/tests [--update]
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+
+static void print_usage(const char *path)
+{
+	printf("usage: %s <path to fxc> <test directory> [--update]\n", path);
+}
+
+static std::string read_file(const std::filesystem::path &path)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::stringstream data;
+	data << file.rdbuf();
+
+	// Expected files may have been checked out with Windows line endings
+	std::string text = data.str();
+	text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
+	return text;
+}
+
+int main(int argc, char *argv[])
+{
+	bool update = false;
+	std::vector<std::filesystem::path> paths;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (0 == strcmp(argv[i], "--update"))
+			update = true;
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.size() != 2)
+	{
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	const std::filesystem::path fxc_path = std::filesystem::absolute(paths[0]);
+	const std::filesystem::path test_path = paths[1];
+	const std::filesystem::path output_path = std::filesystem::temp_directory_path() / "fxc_test_output.txt";
+
+	std::vector<std::filesystem::path> test_files;
+	std::error_code ec;
+	for (const auto &entry : std::filesystem::directory_iterator(test_path, ec))
+		if (entry.path().extension() == ".fx")
+			test_files.push_back(entry.path().filename());
+	std::sort(test_files.begin(), test_files.end());
+
+	if (test_files.empty())
+	{
+		printf("No tests found in '%s'.\n", test_path.u8string().c_str());
+		return 1;
+	}
+
+	// Run from the test directory, so that file names in the output do not depend on where the tests are
+	std::filesystem::current_path(test_path);
+
+	unsigned int failures = 0;
+
+	for (const std::filesystem::path &test_file : test_files)
+	{
+		std::string options;
+		std::getline(std::ifstream(test_file), options);
+		if (options.compare(0, 8, "// fxc: ") != 0)
+		{
+			printf("FAIL %s: the first line does not start with \"// fxc: \"\n", test_file.u8string().c_str());
+			failures++;
+			continue;
+		}
+
+		options.erase(0, 8);
+		if (!options.empty() && options.back() == '\r')
+			options.pop_back();
+
+		std::string command = '\"' + fxc_path.u8string() + "\" " + options + " \"" + test_file.u8string() + "\" > \"" + output_path.u8string() + "\" 2>&1";
+#ifdef _WIN32
+		// The command processor removes the first and last quote of the command line, so add another pair around everything
+		command = '\"' + command + '\"';
+#endif
+		std::system(command.c_str());
+
+		std::filesystem::path expected_file = test_file;
+		expected_file.replace_extension(".expected");
+
+		const std::string output = read_file(output_path);
+
+		if (update)
+		{
+			std::ofstream(expected_file, std::ios::binary).write(output.data(), output.size());
+			printf("UPDATED %s\n", test_file.u8string().c_str());
+			continue;
+		}
+
+		const std::string expected = read_file(expected_file);
+		if (output == expected)
+		{
+			printf("PASS %s\n", test_file.u8string().c_str());
+			continue;
+		}
+
+		// Report the first line that differs, which is usually enough to see what is going on
+		size_t line = 1, offset = 0;
+		for (; offset < output.size() && offset < expected.size() && output[offset] == expected[offset]; ++offset)
+			if (output[offset] == '\n')
+				line++;
+		const size_t line_begin = std::min(output.rfind('\n', offset - (offset != 0)) + 1, offset);
+
+		printf("FAIL %s: output differs from '%s' in line %zu:\n", test_file.u8string().c_str(), expected_file.u8string().c_str(), line);
+		printf("  expected: %s\n", expected.substr(line_begin, expected.find('\n', line_begin) - line_begin).c_str());
+		printf("  actual:   %s\n", output.substr(line_begin, output.find('\n', line_begin) - line_begin).c_str());
+		failures++;
+	}
+
+	std::filesystem::remove(output_path, ec);
+
+	if (failures != 0)
+	{
+		printf("%u of %zu tests failed\n", failures, test_files.size());
+		return 1;
+	}
+
+	return 0;
+}
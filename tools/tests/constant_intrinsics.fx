@@ -0,0 +1,54 @@
+// fxc: --hlsl --shader-model 50
+// Math intrinsics with constant arguments are evaluated at compile-time, unless the result is undefined or not finite, in which case the call is left to the target.
+
+float4 PS_Main(float4 vpos : SV_Position, out float4 pow_domain : SV_Target1, out float4 non_finite : SV_Target2, out float4 smoothstep_edges : SV_Target3, out int4 int_overloads : SV_Target4, out uint4 uint_overloads : SV_Target5) : SV_Target0
+{
+	// The base has to be positive for pow to be defined
+	pow_domain = float4(
+		pow(-2.0, 2.0), // Not folded
+		pow(0.0, 0.0), // Not folded
+		pow(0.0, -1.0), // Not folded
+		pow(4.0, -0.5)); // 0.5
+
+	// Infinities and NaNs are not written as literals
+	non_finite = float4(
+		log(0.0), // -inf, not folded
+		sqrt(-1.0), // NaN, not folded
+		rcp(0.0), // +inf, not folded
+		exp(100.0)); // Overflows to +inf, not folded
+
+	smoothstep_edges = float4(
+		smoothstep(1.0, 1.0, 0.5), // Edges are the same, not folded
+		smoothstep(0.0, 2.0, 1.0), // 0.5
+		smoothstep(0.0, 1.0, -1.0), // 0
+		smoothstep(0.0, 1.0, 2.0)); // 1
+
+	// Integer arguments pick the integer overloads, which are evaluated without going through floating-point
+	int_overloads = int4(
+		abs(-5), // 5
+		abs(int(0x80000000u)), // Stays -2147483648
+		clamp(7, -3, 4), // 4
+		clamp(-7, -3, 4)); // -3
+
+	uint_overloads = uint4(
+		clamp(7u, 2u, 5u), // 5
+		clamp(0xFFFFFFFFu, 2u, 5u), // 5, since the comparison is unsigned
+		clamp(0u, 2u, 5u), // 2
+		clamp(3u, 2u, 5u)); // 3
+
+	return float4(pow(2.0, 0.5), pow(9.0, 0.5), ldexp(1.5, 2), sign(-3)); // 1.41421354, 3, 6, -1
+}
+
+float4 VS_Main(uint id : SV_VertexID) : SV_Position
+{
+	return 0.0;
+}
+
+technique ConstantIntrinsics
+{
+	pass
+	{
+		VertexShader = VS_Main;
+		PixelShader = PS_Main;
+	}
+}
@@ -0,0 +1,40 @@
+// fxc: --hlsl --shader-model 50
+// Identical computations on the same values within a basic block are only done once.
+// Constants are separate values for every use, so only computations on the same variables and intermediate results are shared.
+// Values are not reused across basic blocks, since the block that computed them may not have run.
+
+uniform float2 Scale;
+
+float4 PS_Main(float4 vpos : SV_Position) : SV_Target
+{
+	float2 s = Scale * 2.0;
+	float2 t = vpos.xy + 1.0;
+
+	float2 a = t * s + 0.5;
+	float2 b = t * s + 0.5; // Reuses 't * s' from the line above
+	float2 c = s * t + 0.5; // A different operand order is a different computation
+	float l = length(t * s); // Reuses 't * s' again
+
+	if (vpos.x > 0.5)
+	{
+		a = t * s; // Computed again, this is a different block
+	}
+
+	float2 d = t * s; // And once more after the branch
+
+	return float4(a + b, c + d) * l;
+}
+
+float4 VS_Main(uint id : SV_VertexID) : SV_Position
+{
+	return 0.0;
+}
+
+technique CommonSubexpressions
+{
+	pass
+	{
+		VertexShader = VS_Main;
+		PixelShader = PS_Main;
+	}
+}
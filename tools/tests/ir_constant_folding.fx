@@ -0,0 +1,37 @@
+// fxc: --hlsl --shader-model 50
+// Operators, constructors, casts, swizzles and component-wise intrinsics with constant operands are evaluated at compile-time.
+
+uniform float Input;
+
+float4 PS_Main(float4 vpos : SV_Position) : SV_Target
+{
+	float a = 2.0 * 3.0 + 1.0; // 7
+	int b = 7 / 2 - (5 % 3); // 1
+	uint c = 0xF0u >> 4 | 1u; // 15
+	bool d = a > 6.5 && b == 1; // true
+	float e = (float)b + (float)c; // 16
+	float2 f = float4(1.0, 2.0, 3.0, 4.0).wy; // (4, 2)
+	float3 g = float3(f, a) * 0.5; // (2, 1, 3.5)
+	float h = dot(g, float3(1.0, 2.0, 3.0)); // 14.5
+	float i = clamp(lerp(-1.0, 3.0, 0.25), 0.0, 1.0) + abs(-2.0); // 2
+	float j = pow(2.0, 3.0) + sin(0.0); // 8
+
+	float k = d ? e : 0.0; // 16
+	float l = Input * (a - 7.0); // Only the operand is folded, the product is not zero if 'Input' is infinite or NaN
+
+	return float4(g, h) + float4(i, j, k, l);
+}
+
+float4 VS_Main(uint id : SV_VertexID) : SV_Position
+{
+	return 0.0;
+}
+
+technique ConstantFolding
+{
+	pass
+	{
+		VertexShader = VS_Main;
+		PixelShader = PS_Main;
+	}
+}
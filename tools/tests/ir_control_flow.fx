@@ -0,0 +1,39 @@
+// fxc: --hlsl --shader-model 50
+// Variables written in a branch or loop have to be read again after it, since their value depends on which path was taken.
+
+uniform int Count;
+
+float4 PS_Main(float4 vpos : SV_Position) : SV_Target
+{
+	float sum = vpos.x;
+	float last = sum * 2.0;
+
+	[loop]
+	for (int i = 0; i < Count; ++i)
+	{
+		sum += last; // 'last' is read again in every iteration, since the previous one wrote it
+		last = sum * 0.5;
+	}
+
+	float branch = vpos.y;
+	if (sum > 1.0)
+		branch = sum;
+	else
+		branch *= 2.0;
+
+	return float4(sum, last, branch, sum * 2.0);
+}
+
+float4 VS_Main(uint id : SV_VertexID) : SV_Position
+{
+	return 0.0;
+}
+
+technique ControlFlow
+{
+	pass
+	{
+		VertexShader = VS_Main;
+		PixelShader = PS_Main;
+	}
+}
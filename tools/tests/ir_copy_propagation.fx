@@ -0,0 +1,35 @@
+// fxc: --hlsl --shader-model 50
+// Loads of a variable use the value last stored to it, as long as nothing wrote to the variable in between.
+// The text back-ends refer to loaded values by the name of the variable, so no value may be forwarded across a write to that variable.
+
+uniform float Input;
+
+float4 PS_Main(float4 vpos : SV_Position) : SV_Target
+{
+	float a = Input * 4.0;
+	float b = a; // Forwarded, 'b' is never read from memory
+	float c = b + 1.0;
+
+	a = c * 2.0;
+	float d = a + b; // 'b' still holds the old value of 'a'
+
+	float e = vpos.x;
+	e += 1.0;
+	e += 2.0; // Both writes to 'e' have to be kept in order
+
+	return float4(a, c, d, e);
+}
+
+float4 VS_Main(uint id : SV_VertexID) : SV_Position
+{
+	return 0.0;
+}
+
+technique CopyPropagation
+{
+	pass
+	{
+		VertexShader = VS_Main;
+		PixelShader = PS_Main;
+	}
+}
@@ -0,0 +1,38 @@
+// fxc: --hlsl --shader-model 50
+// Values nothing uses are removed, unless computing them has side effects.
+
+uniform float Input;
+
+float helper(inout float x)
+{
+	x += 1.0;
+	return x * 2.0;
+}
+
+float4 PS_Main(float4 vpos : SV_Position) : SV_Target
+{
+	float unused1 = sin(Input) * 3.0;
+	float unused2 = unused1 + vpos.x;
+
+	float x = vpos.y;
+	helper(x); // The result is unused, but the call writes 'x'
+
+	float2 v = vpos.xy * Input;
+	float y = v.x; // Only the first component of 'v' is used, the vector itself is still computed
+
+	return float4(x, y, 0.0, 1.0);
+}
+
+float4 VS_Main(uint id : SV_VertexID) : SV_Position
+{
+	return 0.0;
+}
+
+technique DeadCode
+{
+	pass
+	{
+		VertexShader = VS_Main;
+		PixelShader = PS_Main;
+	}
+}
@@ -0,0 +1,28 @@
+// fxc: -Od --hlsl --shader-model 50
+// With optimizations disabled the code is passed on to the back-end exactly as the parser generated it.
+
+uniform float Input;
+
+float4 PS_Main(float4 vpos : SV_Position) : SV_Target
+{
+	float a = 2.0 * 3.0 + 1.0; // Constant expressions are still evaluated by the parser
+	float b = Input * a;
+	float c = b; // Stays a separate variable
+	float unused = sin(c);
+
+	return float4(b, c, c * 2.0, c * 2.0);
+}
+
+float4 VS_Main(uint id : SV_VertexID) : SV_Position
+{
+	return 0.0;
+}
+
+technique OptimizationsDisabled
+{
+	pass
+	{
+		VertexShader = VS_Main;
+		PixelShader = PS_Main;
+	}
+}